@@ -2,7 +2,9 @@
 #define STATE_HXX
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <iostream>
+#include <mutex>
 
 static std::stringstream& ss() { static std::stringstream ss; return ss; }
 
@@ -16,10 +18,17 @@ struct Global {
     VAR(bool, Debug, false)
     VAR(std::string, CurrentPath, "")
     VAR(std::string, OutputPath, "")
+    VAR(std::string, PchPath, "")
+    VAR(std::string, CacheDir, "")
+    VAR(uint64_t, CacheSize, 512ull * 1024 * 1024)
+    // "text" or "json" if the preprocessor should be profiled
+    VAR(std::string, StatsFormat, "")
     VAR(bool, CopyOutputToClipboard, false)
     VAR(bool, ParserUnrolling, false)
     #undef VAR
 
+    static std::mutex& GetLogMutex() { static std::mutex mutex; return mutex; }
+
     static void dumpLog() {
         auto& log = Global::GetLog();
         for (const auto& entry : log) {
@@ -1,10 +1,12 @@
 #ifndef ERROR_HXX
 #define ERROR_HXX
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <common/global.hxx>
-#define ERROR(text) { std::stringstream ss; ss << text; Global::GetErrors().push_back(ss.str()); }
-#define WARN(text) { std::stringstream ss; ss << text; Global::GetWarnings().push_back(ss.str()); }
-#define LOG(text) { std::stringstream ss; ss << text; Global::GetLog().push_back(ss.str()); }
+// The log can be written to by many preprocessors running at once
+#define ERROR(text) { std::stringstream ss; ss << text; std::lock_guard<std::mutex> lock(Global::GetLogMutex()); Global::GetErrors().push_back(ss.str()); }
+#define WARN(text) { std::stringstream ss; ss << text; std::lock_guard<std::mutex> lock(Global::GetLogMutex()); Global::GetWarnings().push_back(ss.str()); }
+#define LOG(text) { std::stringstream ss; ss << text; std::lock_guard<std::mutex> lock(Global::GetLogMutex()); Global::GetLog().push_back(ss.str()); }
 #define ERROR_SIZE Global::GetErrors().size()
 #endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef SOURCE_BUFFER_HXX
+#define SOURCE_BUFFER_HXX
+#include <common/uncopyable.hxx>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a source file, memory mapped where possible so that
+// reading a file doesn't copy it
+class SourceBuffer : public Uncopyable {
+public:
+    // IsOpen() is false if the file couldn't be read
+    SourceBuffer(const std::filesystem::path& path) {
+        #ifdef _WIN32
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs.is_open())
+            return;
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        owned_ = ss.str();
+        view_ = owned_;
+        open_ = true;
+        #else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            open_ = true;
+            if (st.st_size > 0) {
+                void* mapping = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping != MAP_FAILED) {
+                    mapping_ = mapping;
+                    mapping_size_ = st.st_size;
+                    view_ = std::string_view(static_cast<const char*>(mapping), mapping_size_);
+                } else {
+                    open_ = false;
+                }
+            }
+        }
+        ::close(fd);
+        #endif
+    }
+
+    ~SourceBuffer() {
+        #ifndef _WIN32
+        if (mapping_)
+            ::munmap(mapping_, mapping_size_);
+        #endif
+    }
+
+    bool IsOpen() const { return open_; }
+    std::string_view View() const { return view_; }
+
+    // Same line semantics as std::getline, a newline at the end of the text doesn't start a new line
+    static std::vector<std::string_view> splitLines(std::string_view text) {
+        std::vector<std::string_view> lines;
+        size_t start = 0;
+        while (start < text.size()) {
+            auto end = text.find('\n', start);
+            if (end == std::string_view::npos) {
+                lines.push_back(text.substr(start));
+                break;
+            }
+            lines.push_back(text.substr(start, end - start));
+            start = end + 1;
+        }
+        return lines;
+    }
+private:
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    std::string owned_;
+    std::string_view view_;
+    bool open_ = false;
+};
+#endif
\ No newline at end of file
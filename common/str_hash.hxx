@@ -1,6 +1,72 @@
 #ifndef STR_HASH_HXX
 #define STR_HASH_HXX
+#include <cstdint>
+#include <cstring>
+#include <string_view>
 constexpr unsigned int hash(const char *s, int off = 0) {                        
     return !s[off] ? 5381 : (hash(s, off+1)*33) ^ s[off];                           
 }
+
+// Same as above for strings that are not null terminated
+constexpr unsigned int hash(std::string_view s) {
+    unsigned int ret = 5381;
+    for (auto i = s.size(); i > 0; i--)
+        ret = (ret * 33) ^ s[i - 1];
+    return ret;
+}
+
+// 64 bit FNV-1a, for hash tables and filters that need more bits than the above
+constexpr uint64_t hash64(std::string_view s) {
+    uint64_t ret = 14695981039346656037ull;
+    for (char c : s) {
+        ret ^= static_cast<unsigned char>(c);
+        ret *= 1099511628211ull;
+    }
+    return ret;
+}
+
+// XXH64, several times faster than the above on long inputs, used to fingerprint file contents
+inline uint64_t xxhash64(std::string_view s, uint64_t seed = 0) {
+    constexpr uint64_t p1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t p2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t p3 = 0x165667B19E3779F9ull;
+    constexpr uint64_t p4 = 0x85EBCA77C2B2AE63ull;
+    constexpr uint64_t p5 = 0x27D4EB2F165667C5ull;
+    auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto read64 = [](const char* p) { uint64_t v; std::memcpy(&v, p, sizeof(v)); return v; };
+    auto read32 = [](const char* p) { uint32_t v; std::memcpy(&v, p, sizeof(v)); return v; };
+    auto round = [&](uint64_t acc, uint64_t input) { return rotl(acc + input * p2, 31) * p1; };
+    auto merge = [&](uint64_t acc, uint64_t value) { return (acc ^ round(0, value)) * p1 + p4; };
+    const char* p = s.data();
+    const char* end = p + s.size();
+    uint64_t h;
+    if (s.size() >= 32) {
+        uint64_t v1 = seed + p1 + p2, v2 = seed + p2, v3 = seed, v4 = seed - p1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge(merge(merge(merge(h, v1), v2), v3), v4);
+    } else {
+        h = seed + p5;
+    }
+    h += s.size();
+    for (; p + 8 <= end; p += 8)
+        h = rotl(h ^ round(0, read64(p)), 27) * p1 + p4;
+    if (p + 4 <= end) {
+        h = rotl(h ^ (read32(p) * p1), 23) * p2 + p3;
+        p += 4;
+    }
+    for (; p < end; p++)
+        h = rotl(h ^ (static_cast<unsigned char>(*p) * p5), 11) * p1;
+    h ^= h >> 33;
+    h *= p2;
+    h ^= h >> 29;
+    h *= p3;
+    h ^= h >> 32;
+    return h;
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef THREAD_POOL_HXX
+#define THREAD_POOL_HXX
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Runs a batch of independent jobs on a fixed set of worker threads
+struct ThreadPool {
+    // Calls job(i) exactly once for every i in [0, count), returns when all of them are done.
+    // threads = 0 uses one thread per hardware thread
+    static void ForEach(size_t count, const std::function<void(size_t)>& job, size_t threads = 0) {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, count);
+        if (threads <= 1) {
+            for (size_t i = 0; i < count; i++)
+                job(i);
+            return;
+        }
+        std::atomic<size_t> next = 0;
+        auto worker = [&]() {
+            for (size_t i = next++; i < count; i = next++)
+                job(i);
+        };
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (size_t i = 1; i < threads; i++)
+            workers.emplace_back(worker);
+        // The calling thread works too
+        worker();
+        for (auto& thread : workers)
+            thread.join();
+    }
+};
+#endif
\ No newline at end of file
@@ -20,6 +20,8 @@ int Dispatcher::Dispatch(std::vector<Command> commands)
     for (auto& action : actions) {
         (*action)();
     }
+    if (!Global::GetStatsFormat().empty())
+        ss() << PreprocessorStats::Report(Global::GetStatsFormat());
     if (Global::GetCopyOutputToClipboard()) {
         Global::copyToClipboard(ss().str());
     } else {
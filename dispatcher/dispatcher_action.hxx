@@ -1,14 +1,20 @@
 #ifndef DISPATCHER_ACTION_HXX
 #define DISPATCHER_ACTION_HXX
 #include <preprocessor/preprocessor.hxx>
+#include <preprocessor/precompiled_header.hxx>
+#include <preprocessor/dependencies.hxx>
 #include <dispatcher/command.hxx>
 #include <lexer/lexer.hxx>
+#include <lexer/token_sink.hxx>
 #include <parser/parser.hxx>
 #include <common/strings.hxx>
+#include <common/source_buffer.hxx>
+#include <common/thread_pool.hxx>
 #include <common/log.hxx>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 
 #define ACTION(name, ...) struct name : public Action { ~name() = default; name(const std::vector<std::string>& args) : Action(args) {} void operator()() override { __VA_ARGS__ } };
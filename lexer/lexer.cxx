@@ -1,111 +1,242 @@
 #include <lexer/lexer.hxx>
-#include <regex>
+#include <token/keywords.hxx>
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <iomanip>
 #include <common/log.hxx>
-#include <misc/scope_guard.hxx>
 
-Lexer::Lexer(const std::string& input)
+namespace {
+    // A character can belong to several classes
+    enum CharClass : uint8_t {
+        IdentifierStart = 1 << 0,
+        IdentifierContinue = 1 << 1,
+        Digit = 1 << 2,
+        Whitespace = 1 << 3,
+        PunctuatorStart = 1 << 4,
+        Quote = 1 << 5,
+    };
+
+    constexpr std::array<uint8_t, 256> char_classes = [] {
+        std::array<uint8_t, 256> table {};
+        for (int c = 'a'; c <= 'z'; c++)
+            table[c] |= IdentifierStart | IdentifierContinue;
+        for (int c = 'A'; c <= 'Z'; c++)
+            table[c] |= IdentifierStart | IdentifierContinue;
+        table['_'] |= IdentifierStart | IdentifierContinue;
+        for (int c = '0'; c <= '9'; c++)
+            table[c] |= Digit | IdentifierContinue;
+        for (unsigned char c : std::string_view(" \t\n\r"))
+            table[c] |= Whitespace;
+        for (unsigned char c : std::string_view(";{},:=()[].&!~-+*/%<>^|?"))
+            table[c] |= PunctuatorStart;
+        table['"'] |= Quote;
+        table['\''] |= Quote;
+        return table;
+    }();
+
+    constexpr bool is(char c, uint8_t classes) {
+        return char_classes[static_cast<unsigned char>(c)] & classes;
+    }
+
+    constexpr bool is_octal(char c) {
+        return c >= '0' && c <= '7';
+    }
+
+    constexpr bool is_hex(char c) {
+        return is(c, Digit) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    // States of the integer constant DFA, the suffix states follow the
+    // (u|U)(l|L|ll|LL)? and (l|L|ll|LL)(u|U)? suffixes
+    enum class NumberState {
+        Zero, Decimal, Octal, HexPrefix, Hex,
+        U, // u
+        UL, // ul, uL
+        Ul, // ul, waiting for a second l
+        L, // L, waiting for a second L or u
+        l, // l, waiting for a second l or u
+        LL, // ll or LL, waiting for u
+        Done, // Complete suffix
+        Invalid,
+    };
+
+    NumberState number_suffix(char c) {
+        switch (c) {
+            case 'u': case 'U': return NumberState::U;
+            case 'l': return NumberState::l;
+            case 'L': return NumberState::L;
+            default: return NumberState::Invalid;
+        }
+    }
+
+    NumberState number_transition(NumberState state, char c) {
+        switch (state) {
+            case NumberState::Zero:
+                if (c == 'x' || c == 'X')
+                    return NumberState::HexPrefix;
+                return is_octal(c) ? NumberState::Octal : number_suffix(c);
+            case NumberState::Octal:
+                return is_octal(c) ? NumberState::Octal : number_suffix(c);
+            case NumberState::Decimal:
+                return is(c, Digit) ? NumberState::Decimal : number_suffix(c);
+            case NumberState::HexPrefix:
+                return is_hex(c) ? NumberState::Hex : NumberState::Invalid;
+            case NumberState::Hex:
+                return is_hex(c) ? NumberState::Hex : number_suffix(c);
+            case NumberState::U:
+                if (c == 'l')
+                    return NumberState::Ul;
+                return c == 'L' ? NumberState::UL : NumberState::Invalid;
+            case NumberState::Ul:
+                return c == 'l' ? NumberState::Done : NumberState::Invalid;
+            case NumberState::UL:
+                return c == 'L' ? NumberState::Done : NumberState::Invalid;
+            case NumberState::l:
+                if (c == 'l')
+                    return NumberState::LL;
+                return c == 'u' || c == 'U' ? NumberState::Done : NumberState::Invalid;
+            case NumberState::L:
+                if (c == 'L')
+                    return NumberState::LL;
+                return c == 'u' || c == 'U' ? NumberState::Done : NumberState::Invalid;
+            case NumberState::LL:
+                return c == 'u' || c == 'U' ? NumberState::Done : NumberState::Invalid;
+            default:
+                return NumberState::Invalid;
+        }
+    }
+}
+
+Lexer::Lexer(std::string_view input)
     : input_(input)
-    , index_(input.begin())
-    , next_token_(TokenType::Empty)
-    , is_string_literal_(false)
-{}
+{
+    // Token offsets are 32 bits
+    if (input_.size() > UINT32_MAX) {
+        ERROR("Lexer input is larger than 4GB: " << input_.size() << " bytes");
+        throw std::runtime_error("Lexer input too large");
+    }
+}
 
 Lexer::~Lexer() {}
 
 std::vector<Token> Lexer::Lex() {
     std::vector<Token> tokens;
-    bool is_eof = false;
-    while (!is_eof) {
-        auto tok = GetNextTokenType();
-        auto [type, _] = tok;
-        is_eof = (type == TokenType::Eof);
-        tokens.push_back(tok);
-    }
+    LexInto(tokens);
+    tokens.push_back(GetNextTokenType());
     return tokens;
 }
 
+void Lexer::LexInto(std::vector<Token>& tokens) {
+    while (true) {
+        auto token = GetNextTokenType();
+        if (token.type == TokenType::Eof)
+            break;
+        tokens.push_back(token);
+    }
+}
+
 void Lexer::Restart() {
-    is_string_literal_ = false;
-    next_token_string_ = "";
-    next_token_ = TokenType::Empty;
-    index_ = input_.begin();
+    index_ = 0;
 }
 
 Token Lexer::GetNextTokenType()
 {
-    ScopeGuard guard([&]() {
-        next_token_string_ = "";
-    });
-    while (index_ != input_.end()) {
-        if (!check(*index_)) {
-            ++index_;
-            return { get_type(), next_token_string_ };
+    while (index_ < input_.size()) {
+        char c = input_[index_];
+        if (is(c, Whitespace)) {
+            index_++;
+            continue;
+        }
+        // The first character decides which part of the DFA scans the token
+        size_t start = index_;
+        TokenType type;
+        if (is(c, IdentifierStart)) {
+            type = lex_word();
+        } else if (is(c, Digit)) {
+            type = lex_number();
+        } else if (c == '"') {
+            if (!lex_string()) {
+                ERROR("Unfinished string literal")
+                return eof();
+            }
+            type = TokenType::StringLiteral;
+        } else if (is(c, PunctuatorStart)) {
+            type = lex_punctuator();
         } else {
-            ++index_;
+            ERROR("Unknown character: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)c);
+            index_++;
+            continue;
         }
+        return { type, static_cast<uint32_t>(start), static_cast<uint32_t>(index_ - start) };
     }
-    if (is_string_literal_)
-        ERROR("Unfinished string literal")
-    else if (!next_token_string_.empty()) {
-        auto type = get_type();
-        std::string ret;
-        next_token_string_.swap(ret);
-        return { type, ret };
-    }
-    return { TokenType::Eof, "" };
+    return eof();
 }
 
-char Lexer::peek(int i) {
-    return *std::next(index_, i);
+Token Lexer::eof() const {
+    return { TokenType::Eof, static_cast<uint32_t>(input_.size()), 0 };
 }
 
-char Lexer::prev() {
-    return *std::prev(index_);
+char Lexer::peek(size_t i) {
+    return index_ + i < input_.size() ? input_[index_ + i] : '\0';
 }
 
-// Check if character belongs to current token
-bool Lexer::check(char c)
-{
-    if (is_string_literal_) {
-        next_token_string_ += c;
-        if (c == '"' && prev() != '\\')
-            return false;
-        return true;
-    }
-
-    if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
-        return next_token_string_.empty();
+TokenType Lexer::lex_word() {
+    size_t start = index_;
+    while (index_ < input_.size() && is(input_[index_], IdentifierContinue))
+        index_++;
+    if (auto keyword = find_keyword(input_.substr(start, index_ - start)); keyword != TokenType::Empty)
+        return keyword;
+    return TokenType::Identifier;
+}
 
-    if (std::regex_match(std::string(1, c), std::regex("[A-Za-z0-9_]"))) {
-        next_token_string_ += c;
-        return true;
+TokenType Lexer::lex_number() {
+    size_t start = index_;
+    auto state = input_[index_++] == '0' ? NumberState::Zero : NumberState::Decimal;
+    TokenType type = state == NumberState::Zero ? TokenType::OctalConstant : TokenType::IntegerConstant;
+    // Letters and digits glued to the constant belong to it, even if they make it invalid
+    while (index_ < input_.size() && is(input_[index_], IdentifierContinue)) {
+        state = number_transition(state, input_[index_++]);
+        if (state == NumberState::HexPrefix)
+            type = TokenType::HexadecimalConstant;
+    }
+    if (state == NumberState::HexPrefix || state == NumberState::Invalid) {
+        ERROR("Unknown token:" << input_.substr(start, index_ - start));
+        return TokenType::Error;
     }
+    return type;
+}
 
-    if (!next_token_string_.empty()) {
-        --index_;
-        return false;
+bool Lexer::lex_string() {
+    // Past the opening quote, a quote ends the literal unless it's right after a backslash
+    index_++;
+    while (index_ < input_.size()) {
+        char c = input_[index_++];
+        if (c == '"' && input_[index_ - 2] != '\\')
+            return true;
     }
+    return false;
+}
 
+TokenType Lexer::lex_punctuator() {
+    char c = input_[index_++];
+    char n = peek(0);
     switch (c) {
         case '>':
         case '<': {
-            next_token_string_ += c;
-            char n = peek(1);
             if (n == c) {
-                ++index_;
-                next_token_string_ += c;
-                char n2 = peek(1);
-                if (n2 == '=') {
-                    ++index_;
-                    next_token_string_ += *index_;
+                index_++;
+                if (peek(0) == '=') {
+                    index_++;
+                    return c == '>' ? TokenType::RightAssign : TokenType::LeftAssign;
                 }
-            } else if (n == '=') {
-                ++index_;
-                next_token_string_ += *index_;
+                return c == '>' ? TokenType::RightOp : TokenType::LeftOp;
             }
-            return false;
+            if (n == '=') {
+                index_++;
+                return c == '>' ? TokenType::GeOp : TokenType::LeOp;
+            }
+            return TokenType::Punctuator;
         }
         case '=':
         case '%':
@@ -113,154 +244,54 @@ bool Lexer::check(char c)
         case '^':
         case '/':
         case '!': {
-            next_token_string_ += c;
-            char n = peek(1);
-            if (n == '=') {
-                ++index_;
-                next_token_string_ += *index_;
+            if (n != '=')
+                return TokenType::Punctuator;
+            index_++;
+            switch (c) {
+                case '=': return TokenType::EqOp;
+                case '%': return TokenType::ModAssign;
+                case '*': return TokenType::MulAssign;
+                case '^': return TokenType::XorAssign;
+                case '/': return TokenType::DivAssign;
+                default: return TokenType::NeOp;
             }
-            return false;
         }
         case '-':
         case '+': {
-            next_token_string_ += c;
-            char n = peek(1);
-            if (n == '=' || n == c || (n == '>' && c == '-')) {
-                ++index_;
-                next_token_string_ += *index_;
+            if (n == '=') {
+                index_++;
+                return c == '+' ? TokenType::AddAssign : TokenType::SubAssign;
+            }
+            if (n == c) {
+                index_++;
+                return c == '+' ? TokenType::IncOp : TokenType::DecOp;
+            }
+            if (n == '>' && c == '-') {
+                index_++;
+                return TokenType::PtrOp;
             }
-            return false;
+            return TokenType::Punctuator;
         }
         case '|':
         case '&': {
-            next_token_string_ += c;
-            char n = peek(1);
-            if (n == '=' || n == c) {
-                ++index_;
-                next_token_string_ += *index_;
+            if (n == '=') {
+                index_++;
+                return c == '|' ? TokenType::OrAssign : TokenType::AndAssign;
+            }
+            if (n == c) {
+                index_++;
+                return c == '|' ? TokenType::OrOp : TokenType::AndOp;
             }
-            return false;
+            return TokenType::Punctuator;
         }
         case '.': {
-            char n = peek(1);
-            char n2 = peek(2);
-            if (n == '.' && n2 == '.') {
+            if (n == '.' && peek(1) == '.') {
                 index_ += 2;
-                next_token_string_ = "...";
-                return false;   
+                return TokenType::Ellipsis;
             }
-            [[fallthrough]];
-        }
-        case '~':
-        case '?': 
-        case ':':
-        case ';':
-        case ',':
-        case '(':
-        case ')':
-        case '{': 
-        case '}': 
-        case '[':
-        case ']': {
-            next_token_string_ += c;
-            return false;
+            return TokenType::Punctuator;
         }
-        case '"': {
-            is_string_literal_ = true;
-            next_token_string_ += c;
-            return true;
-        }
-        default: {
-            ERROR("Unknown character: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)c);
-        }
-    }
-
-    return true;
-}
-
-TokenType Lexer::get_type()
-{
-    #define match(str) std::regex_match(next_token_string_, std::regex(str))
-    #define matchw(str) next_token_string_ == str
-    #define H  "[a-fA-F0-9]"
-    #define O  "[0-7]"
-    #define D  "[0-9]"
-    #define NZ "[1-9]"
-    #define L  "[a-zA-Z_]"
-    #define A  "[a-zA-Z_0-9]"
-    #define H  "[a-fA-F0-9]"
-    #define HP "(0[xX])"
-    #define E  "([Ee][+-]?" D "+)"
-    #define P  "([Pp][+-]?" D "+)"
-    #define FS "(f|F|l|L)"
-    #define IS "(((u|U)(l|L|ll|LL)?)|((l|L|ll|LL)(u|U)?))"
-    #define CP "(u|U|L)"
-    #define SP "(u8|u|U|L)"
-    #define ES R"!((\\(['"\?\\abfnrtv]|[0-7]{1,3}|x[a-fA-F0-9]+)))!"
-    if (is_string_literal_) {
-        is_string_literal_ = false;
-        return TokenType::StringLiteral;
-    } else if (matchw("...")) {
-        return TokenType::Ellipsis;
-    } else if (matchw(">>")) {
-        return TokenType::RightOp;
-    } else if (matchw("<<")) {
-        return TokenType::LeftOp;
-    } else if (matchw(">>=")) {
-        return TokenType::RightAssign;
-    } else if (matchw("<<=")) {
-        return TokenType::LeftAssign;
-    } else if (matchw("+=")) {
-        return TokenType::AddAssign;
-    } else if (matchw("-=")) {
-        return TokenType::SubAssign;
-    } else if (matchw("*=")) {
-        return TokenType::MulAssign;
-    } else if (matchw("/=")) {
-        return TokenType::DivAssign;
-    } else if (matchw("%=")) {
-        return TokenType::ModAssign;
-    } else if (matchw("&=")) {
-        return TokenType::AndAssign;
-    } else if (matchw("^=")) {
-        return TokenType::XorAssign;
-    } else if (matchw("|=")) {
-        return TokenType::OrAssign;
-    } else if (matchw("++")) {
-        return TokenType::IncOp;
-    } else if (matchw("--")) {
-        return TokenType::DecOp;
-    } else if (matchw("==")) {
-        return TokenType::EqOp;
-    } else if (matchw("!=")) {
-        return TokenType::NeOp;
-    } else if (matchw("||")) {
-        return TokenType::OrOp;
-    } else if (matchw("&&")) {
-        return TokenType::AndOp;
-    } else if (matchw(">=")) {
-        return TokenType::GeOp;
-    } else if (matchw("<=")) {
-        return TokenType::LeOp;
-    } else if (matchw("->")) {
-        return TokenType::PtrOp;
-    } else if (match("[;\\{\\},:=\\(\\)\\[\\].&!~\\-\\+\\*/%<>^\\|?]")) {
-        return TokenType::Punctuator;
-    } else if (auto tok = serialize_l(next_token_string_); tok != TokenType::Empty) {
-        return tok;
-    } else if (match("[A-Za-z_][A-Za-z0-9_]*")) {
-        return TokenType::Identifier;
-    } else if (match(NZ D "*" IS "?")) {
-        return TokenType::IntegerConstant;
-    } else if (match(HP H "+" IS "?")) {
-        return TokenType::HexadecimalConstant;
-    } else if (match("0" O "*" IS "?")) {
-        return TokenType::OctalConstant;
-    } else if (match("L?'(\\.|[^\\'\n])+'")) {
-        return TokenType::CharacterConstant;
+        default:
+            return TokenType::Punctuator;
     }
-    #undef match
-    #undef matchw
-    ERROR("Unknown token:" << next_token_string_);
-    return TokenType::Error;
 }
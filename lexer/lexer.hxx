@@ -1,27 +1,34 @@
 #ifndef LEXER_HXX
 #define LEXER_HXX
 #include <string>
-#include <tuple>
+#include <string_view>
+#include <vector>
 #include <token/token.hxx>
 #include <common/uncopyable.hxx>
 
 class Lexer : public Uncopyable {
 public:
-    Lexer(const std::string& input);
+    Lexer(std::string_view input);
     ~Lexer();
 
+    // The tokens point into the input, which has to outlive them
     std::vector<Token> Lex();
+    // Appends the tokens to the vector, without the end of file token
+    void LexInto(std::vector<Token>& tokens);
     Token GetNextTokenType();
     void Restart();
 private:
-    const std::string& input_;
-    std::string::const_iterator index_;
-    TokenType next_token_;
-    std::string next_token_string_;
-    bool is_string_literal_;
-    char peek(int i);
-    char prev();
-    bool check(char c);
-    TokenType get_type();
+    std::string_view input_;
+    size_t index_ = 0;
+    // Character at the given distance from the current one, '\0' past the end
+    char peek(size_t i);
+    // Empty token at the end of the input
+    Token eof() const;
+    // Each scans one kind of token starting at the current character
+    TokenType lex_word();
+    TokenType lex_number();
+    // Returns false if the literal isn't closed
+    bool lex_string();
+    TokenType lex_punctuator();
 };
 #endif
\ No newline at end of file
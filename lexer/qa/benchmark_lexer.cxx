@@ -0,0 +1,48 @@
+#include <lexer/lexer.hxx>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Measures lexer throughput on the compare corpus, repeated until it reaches the
+// size given in megabytes as the first argument (1 by default)
+int main(int argc, char** argv) {
+    const double megabytes = argc > 1 ? std::stod(argv[1]) : 1.0;
+    constexpr int runs = 5;
+    std::string corpus;
+    for (const auto& entry : std::filesystem::directory_iterator(BENCHMARK_DATA_FILEPATH "/compare/src")) {
+        if (!entry.is_regular_file())
+            continue;
+        std::ifstream ifs(entry.path());
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        corpus += ss.str();
+        corpus += '\n';
+    }
+    if (corpus.empty()) {
+        std::cout << "No benchmark data found" << std::endl;
+        return 1;
+    }
+    std::string source;
+    while (source.size() < megabytes * 1024 * 1024)
+        source += corpus;
+    double best = 0;
+    size_t token_count = 0;
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        Lexer lexer(source);
+        auto tokens = lexer.Lex();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        token_count = tokens.size();
+        if (run == 0 || elapsed.count() < best)
+            best = elapsed.count();
+    }
+    std::cout << std::setw(12) << "MB" << std::setw(12) << "tokens" << std::setw(12) << "ms" << std::setw(12) << "MB/s" << std::endl;
+    std::cout << std::fixed << std::setprecision(1)
+        << std::setw(12) << source.size() / (1024.0 * 1024) << std::setw(12) << token_count
+        << std::setw(12) << best * 1000 << std::setw(12) << source.size() / best / (1024 * 1024) << std::endl;
+    return 0;
+}
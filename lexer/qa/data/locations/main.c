@@ -0,0 +1,7 @@
+#include "header.h"
+/* a comment
+spanning
+lines */
+int main() {
+    return VALUE;
+}
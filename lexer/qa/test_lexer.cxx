@@ -1,16 +1,20 @@
 #include <lexer/lexer.hxx>
+#include <lexer/token_sink.hxx>
 #include <preprocessor/preprocessor.hxx>
 #include <common/qa/test_base.hxx>
 #include <filesystem>
-#include <tuple>
 #include <vector>
 #include <fstream>
 
 class TestLexer : public TestBase {
     std::string lexFile(std::string src);
     void lexTestFiles();
+    void lexKeywords();
+    void lexIntoTokenBuffer();
     CPPUNIT_TEST_SUITE(TestLexer);
     CPPUNIT_TEST(lexTestFiles);
+    CPPUNIT_TEST(lexKeywords);
+    CPPUNIT_TEST(lexIntoTokenBuffer);
     CPPUNIT_TEST_SUITE_END();
 };
 
@@ -20,17 +24,15 @@ std::string TestLexer::lexFile(std::string src) {
     Preprocessor preprocessor(src);
     src = preprocessor.Process();
     Lexer lexer(src);
-    TokenType token = TokenType::Empty;
-    while (token != TokenType::Eof) {
-        auto [temptoken, name] = lexer.GetNextTokenType();
-        if (temptoken != TokenType::Eof)
-            tokens.push_back({temptoken, name});
-        token = temptoken;
-    }
-    for (size_t i = 0; i < tokens.size(); i++) {
-        const auto& [type, value] = tokens[i];
-        ss << value << " " << static_cast<int>(type) << "\n";
+    TokenType type = TokenType::Empty;
+    while (type != TokenType::Eof) {
+        auto token = lexer.GetNextTokenType();
+        if (token.type != TokenType::Eof)
+            tokens.push_back(token);
+        type = token.type;
     }
+    for (const auto& token : tokens)
+        ss << token.Text(src) << " " << static_cast<int>(token.type) << "\n";
     std::string ret = ss.str();
     return ret;
 }
@@ -59,5 +61,73 @@ void TestLexer::lexTestFiles() {
     }
 }
 
+void TestLexer::lexKeywords() {
+    // Only the exact spellings are keywords, not the names of the token types
+    Lexer lexer("while _Bool static integerConstant eof Auto bool whilex");
+    std::vector<TokenType> expected {
+        TokenType::While, TokenType::Bool, TokenType::Static, TokenType::Identifier,
+        TokenType::Identifier, TokenType::Identifier, TokenType::Identifier, TokenType::Identifier,
+        TokenType::Eof,
+    };
+    auto tokens = lexer.Lex();
+    CPPUNIT_ASSERT_EQUAL(expected.size(), tokens.size());
+    for (size_t i = 0; i < expected.size(); i++)
+        CPPUNIT_ASSERT_EQUAL(expected[i], tokens[i].type);
+}
+
+void TestLexer::lexIntoTokenBuffer() {
+    // Tokens of later chunks point past the earlier ones
+    TokenBuffer tokens;
+    TokenSink sink(tokens);
+    sink.Write("int x;\n");
+    sink.SetLocation("main.c", 10);
+    sink.Write("  return x;\n");
+    tokens.AppendEof();
+    std::vector<TokenType> expected {
+        TokenType::Int, TokenType::Identifier, TokenType::Punctuator,
+        TokenType::Return, TokenType::Identifier, TokenType::Punctuator, TokenType::Eof,
+    };
+    CPPUNIT_ASSERT_EQUAL(expected.size(), tokens.Size());
+    for (size_t i = 0; i < expected.size(); i++)
+        CPPUNIT_ASSERT_EQUAL(expected[i], tokens.Kind(i));
+    CPPUNIT_ASSERT(tokens.Text(3) == "return");
+    CPPUNIT_ASSERT(tokens.Text(4) == "x");
+    CPPUNIT_ASSERT(tokens.Text(6).empty());
+    // Lines with a recorded origin are located in their file
+    auto location = tokens.GetLocation(3);
+    CPPUNIT_ASSERT(location.file == "main.c");
+    CPPUNIT_ASSERT_EQUAL(size_t(10), location.line);
+    CPPUNIT_ASSERT_EQUAL(size_t(3), location.column);
+    // Others in the output
+    location = tokens.GetLocation(2);
+    CPPUNIT_ASSERT(location.file.empty());
+    CPPUNIT_ASSERT_EQUAL(size_t(1), location.line);
+    CPPUNIT_ASSERT_EQUAL(size_t(6), location.column);
+    // Going back to a file seen before, then to the latest one again
+    sink.SetLocation("header.h", 1);
+    sink.Write("a;\n");
+    sink.SetLocation("main.c", 11);
+    sink.Write("b;\n");
+    sink.SetLocation("header.h", 2);
+    sink.Write("c;\n");
+    CPPUNIT_ASSERT(tokens.Text(tokens.Size() - 2) == "c");
+    location = tokens.GetLocation(tokens.Size() - 2);
+    CPPUNIT_ASSERT(location.file == "header.h");
+    CPPUNIT_ASSERT_EQUAL(size_t(2), location.line);
+    // Includes and comments don't shift the lines of the tokens after them
+    auto path = getDataPath() + "/locations/main.c";
+    auto src = getSource(path);
+    Preprocessor preprocessor(src, path);
+    TokenBuffer file_tokens;
+    TokenSink file_sink(file_tokens);
+    preprocessor.Process(file_sink);
+    CPPUNIT_ASSERT(file_tokens.Size() > 0);
+    auto last = file_tokens.Size() - 1;
+    CPPUNIT_ASSERT(file_tokens.Text(last) == "}");
+    location = file_tokens.GetLocation(last);
+    CPPUNIT_ASSERT(location.file == path);
+    CPPUNIT_ASSERT_EQUAL(size_t(7), location.line);
+    CPPUNIT_ASSERT_EQUAL(size_t(1), location.column);
+}
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestLexer);
\ No newline at end of file
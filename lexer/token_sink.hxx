@@ -0,0 +1,36 @@
+#ifndef TOKEN_SINK_HXX
+#define TOKEN_SINK_HXX
+#include <lexer/lexer.hxx>
+#include <preprocessor/output_sink.hxx>
+#include <token/token_buffer.hxx>
+#include <vector>
+
+// Lexes the preprocessor output line by line as it's produced, so that it's lexed
+// while it's still in cache. The preprocessor only writes whole lines and no token
+// spans a line after comments and backslash-newlines are removed, so every chunk can
+// be lexed on its own. The chunks become the source of the token buffer, which the
+// tokens point into, so the whole output is still kept as one string.
+// Lines without macros are only tokenized here, lines the expander tokenized to
+// expand their macros are tokenized again since its preprocessing tokens don't carry
+// the token types. So this is not a single pass from the source to tokens: the
+// preprocessor still produces text and the lexer still scans all of it
+class TokenSink : public OutputSink {
+public:
+    TokenSink(TokenBuffer& tokens) : tokens_(tokens) {}
+    void Write(std::string_view chunk) override {
+        auto offset = tokens_.AppendSource(chunk);
+        chunk_tokens_.clear();
+        Lexer lexer(tokens_.Source().substr(offset));
+        lexer.LexInto(chunk_tokens_);
+        for (const auto& token : chunk_tokens_)
+            tokens_.Append(token.type, token.offset + offset, token.length);
+    }
+    void SetLocation(std::string_view file, size_t line) override {
+        tokens_.SetOrigin(file, line);
+    }
+private:
+    TokenBuffer& tokens_;
+    // Reused between chunks
+    std::vector<Token> chunk_tokens_;
+};
+#endif
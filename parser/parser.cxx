@@ -1,23 +1,22 @@
 #include <lexer/lexer.hxx>
+#include <lexer/token_sink.hxx>
 #include <parser/parser.hxx>
 #include <preprocessor/preprocessor.hxx>
 #include <common/log.hxx>
 #include <regex>
 #include <boost/stacktrace.hpp>
 
-Parser::Parser(const std::string& input)
+Parser::Parser(std::string_view input)
     : input_(input)
     , tokens_{}
-    , index_(nullptr)
     , start_node_{}
 {
-    std::string unprocessed = input_;
-    Preprocessor preprocessor(unprocessed);
-    auto processed = preprocessor.Process();
-    Lexer lexer(processed);
-    tokens_ = lexer.Lex();
-    index_ = tokens_.begin();
-    assert(tokens_.size() > 0);
+    // The preprocessor output is lexed as it's produced instead of being collected first
+    Preprocessor preprocessor(input_);
+    TokenSink sink(tokens_);
+    preprocessor.Process(sink);
+    tokens_.AppendEof();
+    assert(tokens_.Size() > 0);
 }
 
 Parser::~Parser() {}
@@ -29,17 +28,16 @@ void Parser::Parse() {
         find_error();
     }
     ++index_;
-    assert(index_ == tokens_.end());
+    assert(index_ == tokens_.Size());
 }
 
 void Parser::find_error() {
-    int i = index_ - tokens_.begin();
-    int j = 0;
     int indentation = 0;
     bool first = false;
     std::cout << "Trying to find error:" << std::endl;
-    for (auto& [tok, value] : tokens_) {
-        if (j == i) {
+    for (size_t j = 0; j < tokens_.Size(); j++) {
+        auto value = tokens_.Text(j);
+        if (j == index_) {
             std::cout << "\033[31m";
         }
         if (first) {
@@ -49,7 +47,7 @@ void Parser::find_error() {
             first = false;
         }
         std::cout << value;
-        switch (hash(value.c_str())) {
+        switch (hash(value)) {
             case hash("{"): {
                 indentation++;
                 std::cout << std::endl;
@@ -66,10 +64,9 @@ void Parser::find_error() {
                 break;
             }
         }
-        if (j == i) {
+        if (j == index_) {
             std::cout << "\033[0m";
         }
-        j++;
     }
 }
 
@@ -79,7 +76,7 @@ void Parser::parser_error() {
 }
 
 const ASTNodePtr& Parser::GetStartNode() {
-    if (index_ != tokens_.end()) {
+    if (index_ != tokens_.Size()) {
         ERROR("Parse failed before GetStartNode");
         parser_error();
     }
@@ -1789,10 +1786,7 @@ std::string Parser::get_unique_name(std::string name) {
 }
 
 TokenType Parser::get_token_type(int offset) {
-    index_ += offset;
-    auto ret = std::get<0>(*index_);
-    index_ -= offset;
-    return ret;
+    return tokens_.Kind(index_ + offset);
 }
 
 bool Parser::check_ahead(func_ptr aptr, int offset) {
@@ -1802,8 +1796,18 @@ bool Parser::check_ahead(func_ptr aptr, int offset) {
     return ret != nullptr;
 }
 
-std::string Parser::get_token_value() {
-    return std::get<1>(*index_);
+std::string_view Parser::get_token_value() {
+    return tokens_.Text(index_);
+}
+
+std::string Parser::get_token_location() {
+    auto location = tokens_.GetLocation(index_);
+    std::stringstream ss;
+    if (location.file.empty())
+        ss << location.line << ":" << location.column << " of the preprocessed output";
+    else
+        ss << location.file << ":" << location.line << ":" << location.column;
+    return ss.str();
 }
 
 bool Parser::advance_if(bool adv) {
@@ -1813,18 +1817,18 @@ bool Parser::advance_if(bool adv) {
 
 void Parser::consume(char c) {
     if (!is_punctuator(c)) {
-        std::cout << "Expected " << c << " but got " << get_token_value() << std::endl;
+        std::cout << "Expected " << c << " but got " << get_token_value() << " at " << get_token_location() << std::endl;
         parser_error();
     }
 }
 
 void Parser::consume(TokenType t) {
     if (!advance_if(get_token_type() == t)) {
-        std::cout << "Expected " << deserialize(t) << " but got " << get_token_value() << std::endl;
+        std::cout << "Expected " << deserialize(t) << " but got " << get_token_value() << " at " << get_token_location() << std::endl;
         parser_error();
     }
 }
 
-bool Parser::type_defined(const std::string& str) {
-    return typedefs_.find(str) != typedefs_.end();
+bool Parser::type_defined(std::string_view str) {
+    return typedefs_.find(std::string(str)) != typedefs_.end();
 }
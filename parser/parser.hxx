@@ -2,7 +2,7 @@
 #define PARSER_HXX
 #include <parser/parser_node.hxx>
 #include <parser/parser_defines.hxx>
-#include <token/token.hxx>
+#include <token/token_buffer.hxx>
 #include <string>
 #include <vector>
 #include <algorithm>
@@ -10,7 +10,7 @@
 
 class Parser {
 public:
-    Parser(const std::string& input);
+    Parser(std::string_view input);
     ~Parser();
 
     void Parse();
@@ -116,15 +116,16 @@ public:
     }
 
     TokenType get_token_type(int offset = 0);
-    std::string get_token_value();
+    std::string_view get_token_value();
+    std::string get_token_location();
     std::string get_unique_name(std::string);
     bool advance_if(bool adv);
-    bool type_defined(const std::string& type);
+    bool type_defined(std::string_view type);
     using func_ptr = ASTNodePtr (Parser::*)();
     bool check_ahead(func_ptr aptr, int offset = 0);
-    const std::string& input_;
-    std::vector<Token> tokens_;
-    std::vector<Token>::const_iterator index_;
+    std::string_view input_;
+    TokenBuffer tokens_;
+    size_t index_ = 0;
     ASTNodePtr start_node_;
     std::stringstream uml_ss_;
     std::unordered_map<std::string, int> uml_value_count_ {};
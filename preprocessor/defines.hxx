@@ -0,0 +1,42 @@
+#ifndef DEFINES_HXX
+#define DEFINES_HXX
+#include <preprocessor/pp_token.hxx>
+#include <preprocessor/macro_table.hxx>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Part of a function-like macro body, either a run of body tokens or an argument
+struct MacroSlot {
+    enum class Type : uint8_t {
+        Literal, // tokens[begin, end)
+        Argument, // Fully expanded argument number begin
+        RawArgument, // Unexpanded argument number begin, used next to ##
+        Stringify, // #argument
+    };
+    Type type;
+    // Glue the first token of this slot to the last token before it (##)
+    bool paste = false;
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    // Whitespace before the parameter in the body, unused by literals
+    std::string_view whitespace;
+};
+
+// Function-like macro body precompiled at definition time, so that an invocation
+// only splices the arguments between the literal token runs
+struct MacroTemplate {
+    int arg_count = 0;
+    std::vector<std::string> parameters;
+    // Shared so that copies of the template keep the token views valid
+    std::shared_ptr<const std::string> body;
+    std::vector<PPToken> tokens;
+    std::vector<MacroSlot> slots;
+};
+
+// Object-like macro bodies are stored in the table's arena
+using Defines = MacroTable<std::string_view>;
+using FuncDefines = MacroTable<MacroTemplate>;
+#endif
\ No newline at end of file
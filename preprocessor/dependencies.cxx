@@ -0,0 +1,74 @@
+#include <preprocessor/dependencies.hxx>
+#include <preprocessor/preprocessor.hxx>
+#include <common/source_buffer.hxx>
+#include <common/thread_pool.hxx>
+#include <common/log.hxx>
+#include <misc/json.hpp>
+#include <filesystem>
+#include <sstream>
+
+namespace {
+    // Make treats spaces as separators and $ as a variable reference
+    std::string escape_make(const std::string& path) {
+        std::string ret;
+        ret.reserve(path.size());
+        for (char c : path) {
+            if (c == ' ' || c == '#')
+                ret += '\\';
+            else if (c == '$')
+                ret += '$';
+            ret += c;
+        }
+        return ret;
+    }
+}
+
+Dependencies Dependencies::scan(const std::vector<std::string>& paths) {
+    std::vector<std::vector<std::string>> results(paths.size());
+    // Not vector<bool>, its elements can't be written from different threads
+    std::vector<char> succeeded(paths.size(), false);
+    ThreadPool::ForEach(paths.size(), [&](size_t i) {
+        SourceBuffer source(paths[i]);
+        if (!source.IsOpen()) {
+            ERROR("File not found: " << paths[i]);
+            return;
+        }
+        Preprocessor preprocessor(source.View(), paths[i]);
+        try {
+            results[i] = preprocessor.ScanDependencies();
+            succeeded[i] = true;
+        } catch (const std::exception&) {
+            // Already reported by the preprocessor
+        }
+    });
+    Dependencies ret;
+    for (size_t i = 0; i < paths.size(); i++)
+        if (succeeded[i])
+            ret.files.emplace_back(paths[i], std::move(results[i]));
+    return ret;
+}
+
+std::string Dependencies::ToMakefile() const {
+    std::stringstream ss;
+    for (const auto& [file, headers] : files) {
+        auto target = std::filesystem::path(file).replace_extension(".o").string();
+        ss << escape_make(target) << ": " << escape_make(file);
+        for (const auto& header : headers)
+            ss << " \\\n  " << escape_make(header);
+        ss << "\n";
+    }
+    return ss.str();
+}
+
+std::string Dependencies::ToJson() const {
+    nlohmann::json j;
+    std::vector<nlohmann::json> objects;
+    for (const auto& [file, headers] : files) {
+        nlohmann::json obj;
+        obj["File"] = file;
+        obj["Dependencies"] = headers;
+        objects.push_back(obj);
+    }
+    j["Files"] = objects;
+    return j.dump(4);
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef DEPENDENCIES_HXX
+#define DEPENDENCIES_HXX
+#include <string>
+#include <utility>
+#include <vector>
+
+// Headers included by a set of source files, found by evaluating only the
+// preprocessor directives of each file
+struct Dependencies {
+    // Source file and the canonical paths of the headers it includes, in the order they are first included
+    std::vector<std::pair<std::string, std::vector<std::string>>> files;
+
+    // Scans the files in parallel, files that fail to preprocess are reported and left out
+    static Dependencies scan(const std::vector<std::string>& paths);
+
+    // One "file.o: file.c headers..." rule per file
+    std::string ToMakefile() const;
+    std::string ToJson() const;
+};
+#endif
\ No newline at end of file
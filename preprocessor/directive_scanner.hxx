@@ -0,0 +1,123 @@
+#ifndef DIRECTIVE_SCANNER_HXX
+#define DIRECTIVE_SCANNER_HXX
+#include <common/str_hash.hxx>
+#include <string_view>
+
+enum class DirectiveType {
+    None, // Not a directive line
+    Empty, // A lone '#'
+    Unknown,
+    #define DEF(type, keyword) type,
+    #include <preprocessor/directives.def>
+    #undef DEF
+};
+
+// Linear cursor over a single line, used to recognize preprocessor directives
+// and extract their operands without backtracking
+class DirectiveScanner {
+public:
+    DirectiveScanner(std::string_view line) : line_(line) {}
+
+    // Reads the directive keyword, leaving the cursor right after it
+    DirectiveType Scan() {
+        index_ = 0;
+        SkipWhitespace();
+        if (!Consume('#'))
+            return DirectiveType::None;
+        SkipWhitespace();
+        if (AtEnd())
+            return DirectiveType::Empty;
+        return getDirectiveType(ReadIdentifier());
+    }
+
+    void SkipWhitespace() {
+        while (index_ < line_.size() && (line_[index_] == ' ' || line_[index_] == '\t'))
+            index_++;
+    }
+
+    bool Consume(char c) {
+        if (index_ < line_.size() && line_[index_] == c) {
+            index_++;
+            return true;
+        }
+        return false;
+    }
+
+    char Peek() {
+        return index_ < line_.size() ? line_[index_] : '\0';
+    }
+
+    // Skips leading whitespace, returns an empty view if there's no identifier
+    std::string_view ReadIdentifier() {
+        SkipWhitespace();
+        auto start = index_;
+        if (index_ < line_.size() && isIdentifierStart(line_[index_])) {
+            index_++;
+            while (index_ < line_.size() && isIdentifier(line_[index_]))
+                index_++;
+        }
+        return line_.substr(start, index_ - start);
+    }
+
+    // Reads everything up to (not including) the delimiter and consumes the delimiter,
+    // returns false if the delimiter was not found
+    bool ReadUntil(char delimiter, std::string_view& out) {
+        auto end = line_.find(delimiter, index_);
+        if (end == std::string_view::npos)
+            return false;
+        out = line_.substr(index_, end - index_);
+        index_ = end + 1;
+        return true;
+    }
+
+    // Rest of the line with surrounding whitespace trimmed
+    std::string_view Rest() {
+        SkipWhitespace();
+        auto rest = line_.substr(index_);
+        auto end = rest.find_last_not_of(" \t\r");
+        return end == std::string_view::npos ? std::string_view() : rest.substr(0, end + 1);
+    }
+
+    size_t Position() const { return index_; }
+
+    bool AtEnd() {
+        SkipWhitespace();
+        return index_ >= line_.size() || line_[index_] == '\r';
+    }
+
+    static DirectiveType getDirectiveType(std::string_view keyword) {
+        switch (hash(keyword)) {
+            #define DEF(type, keyword_str) case hash(keyword_str): return keyword == keyword_str ? DirectiveType::type : DirectiveType::Unknown;
+            #include <preprocessor/directives.def>
+            #undef DEF
+            default: return DirectiveType::Unknown;
+        }
+    }
+
+    // #if, #ifdef, #ifndef, #elif, #else and #endif, the directives that still count in inactive regions
+    static constexpr bool isConditional(DirectiveType type) {
+        switch (type) {
+            case DirectiveType::If:
+            case DirectiveType::Ifdef:
+            case DirectiveType::Ifndef:
+            case DirectiveType::Elif:
+            case DirectiveType::Else:
+            case DirectiveType::Endif:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static constexpr bool isIdentifierStart(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    static constexpr bool isIdentifier(char c) {
+        return isIdentifierStart(c) || (c >= '0' && c <= '9');
+    }
+private:
+    std::string_view line_;
+    size_t index_ = 0;
+};
+#endif
\ No newline at end of file
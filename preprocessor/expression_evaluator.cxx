@@ -0,0 +1,378 @@
+#include <preprocessor/expression_evaluator.hxx>
+#include <preprocessor/directive_scanner.hxx>
+#include <limits>
+
+bool ExpressionEvaluator::Evaluate(bool& result) {
+    index_ = 0;
+    error_ = {};
+    next();
+    auto value = parse_expression(1);
+    if (kind_ != Kind::End)
+        fail("unexpected token in #if expression");
+    result = value.value != 0;
+    return error_.empty();
+}
+
+int ExpressionEvaluator::precedence(Kind kind) {
+    switch (kind) {
+        case Kind::Star:
+        case Kind::Slash:
+        case Kind::Percent: return 12;
+        case Kind::Plus:
+        case Kind::Minus: return 11;
+        case Kind::LeftShift:
+        case Kind::RightShift: return 10;
+        case Kind::Less:
+        case Kind::Greater:
+        case Kind::LessEqual:
+        case Kind::GreaterEqual: return 9;
+        case Kind::Equal:
+        case Kind::NotEqual: return 8;
+        case Kind::BitAnd: return 7;
+        case Kind::BitXor: return 6;
+        case Kind::BitOr: return 5;
+        case Kind::And: return 4;
+        case Kind::Or: return 3;
+        case Kind::Question: return 2;
+        case Kind::Comma: return 1;
+        default: return 0;
+    }
+}
+
+ExpressionEvaluator::Value ExpressionEvaluator::parse_expression(int min_precedence) {
+    auto lhs = parse_unary();
+    while (error_.empty()) {
+        auto op = kind_;
+        int op_precedence = precedence(op);
+        if (op_precedence == 0 || op_precedence < min_precedence)
+            break;
+        next();
+        bool saved = evaluating_;
+        switch (op) {
+            case Kind::And:
+            case Kind::Or: {
+                bool lhs_true = lhs.value != 0;
+                // The right operand is only evaluated if it decides the result
+                evaluating_ = saved && (op == Kind::And ? lhs_true : !lhs_true);
+                auto rhs = parse_expression(op_precedence + 1);
+                evaluating_ = saved;
+                bool result = op == Kind::And ? lhs_true && rhs.value != 0 : lhs_true || rhs.value != 0;
+                lhs = { result, false };
+                break;
+            }
+            case Kind::Question: {
+                bool condition = lhs.value != 0;
+                evaluating_ = saved && condition;
+                auto if_true = parse_expression(1);
+                if (kind_ != Kind::Colon) {
+                    fail("expected ':' in #if expression");
+                    break;
+                }
+                next();
+                evaluating_ = saved && !condition;
+                // Right associative
+                auto if_false = parse_expression(op_precedence);
+                evaluating_ = saved;
+                lhs = condition ? if_true : if_false;
+                lhs.is_unsigned = if_true.is_unsigned || if_false.is_unsigned;
+                break;
+            }
+            case Kind::Comma: {
+                lhs = parse_expression(op_precedence + 1);
+                break;
+            }
+            default: {
+                auto rhs = parse_expression(op_precedence + 1);
+                lhs = apply(op, lhs, rhs);
+                break;
+            }
+        }
+    }
+    return lhs;
+}
+
+ExpressionEvaluator::Value ExpressionEvaluator::parse_unary() {
+    auto kind = kind_;
+    auto text = text_;
+    switch (kind) {
+        case Kind::Number: {
+            next();
+            return parse_number(text);
+        }
+        case Kind::Character: {
+            next();
+            return parse_character(text);
+        }
+        case Kind::Identifier: {
+            next();
+            // Identifiers left after macro expansion evaluate to 0
+            return { text == "true" ? 1 : 0, false };
+        }
+        case Kind::LeftParen: {
+            next();
+            auto value = parse_expression(1);
+            if (kind_ != Kind::RightParen)
+                fail("expected ')' in #if expression");
+            else
+                next();
+            return value;
+        }
+        case Kind::Plus:
+        case Kind::Minus:
+        case Kind::Tilde:
+        case Kind::Not: {
+            next();
+            auto value = parse_unary();
+            auto bits = static_cast<uintmax_t>(value.value);
+            switch (kind) {
+                case Kind::Minus: value.value = static_cast<intmax_t>(0 - bits); break;
+                case Kind::Tilde: value.value = static_cast<intmax_t>(~bits); break;
+                case Kind::Not: value = { value.value == 0, false }; break;
+                default: break;
+            }
+            return value;
+        }
+        case Kind::End: {
+            fail("missing operand in #if expression");
+            return {};
+        }
+        default: {
+            fail("unexpected token in #if expression");
+            return {};
+        }
+    }
+}
+
+ExpressionEvaluator::Value ExpressionEvaluator::apply(Kind op, Value lhs, Value rhs) {
+    // Usual arithmetic conversions, shifts keep the type of the left operand
+    bool is_unsigned = lhs.is_unsigned || rhs.is_unsigned;
+    auto l = static_cast<uintmax_t>(lhs.value);
+    auto r = static_cast<uintmax_t>(rhs.value);
+    // Arithmetic is done on unsigned values so signed overflow wraps instead of being undefined
+    auto make = [](uintmax_t value, bool is_unsigned) { return Value { static_cast<intmax_t>(value), is_unsigned }; };
+    auto less = [&](Value a, Value b) {
+        return is_unsigned ? static_cast<uintmax_t>(a.value) < static_cast<uintmax_t>(b.value) : a.value < b.value;
+    };
+    switch (op) {
+        case Kind::Star: return make(l * r, is_unsigned);
+        case Kind::Slash:
+        case Kind::Percent: {
+            if (r == 0) {
+                if (evaluating_)
+                    fail("division by zero in #if expression");
+                return { 0, is_unsigned };
+            }
+            if (is_unsigned)
+                return make(op == Kind::Slash ? l / r : l % r, true);
+            if (lhs.value == std::numeric_limits<intmax_t>::min() && rhs.value == -1)
+                return { op == Kind::Slash ? lhs.value : 0, false };
+            return { op == Kind::Slash ? lhs.value / rhs.value : lhs.value % rhs.value, false };
+        }
+        case Kind::Plus: return make(l + r, is_unsigned);
+        case Kind::Minus: return make(l - r, is_unsigned);
+        case Kind::LeftShift:
+        case Kind::RightShift: {
+            constexpr int bits = std::numeric_limits<uintmax_t>::digits;
+            if (rhs.value < 0 || rhs.value >= bits)
+                return { op == Kind::RightShift && !lhs.is_unsigned && lhs.value < 0 ? -1 : 0, lhs.is_unsigned };
+            if (op == Kind::LeftShift)
+                return make(l << r, lhs.is_unsigned);
+            if (lhs.is_unsigned)
+                return make(l >> r, true);
+            return { lhs.value >> rhs.value, false };
+        }
+        case Kind::Less: return { less(lhs, rhs), false };
+        case Kind::Greater: return { less(rhs, lhs), false };
+        case Kind::LessEqual: return { !less(rhs, lhs), false };
+        case Kind::GreaterEqual: return { !less(lhs, rhs), false };
+        case Kind::Equal: return { l == r, false };
+        case Kind::NotEqual: return { l != r, false };
+        case Kind::BitAnd: return make(l & r, is_unsigned);
+        case Kind::BitXor: return make(l ^ r, is_unsigned);
+        case Kind::BitOr: return make(l | r, is_unsigned);
+        default: return lhs;
+    }
+}
+
+ExpressionEvaluator::Value ExpressionEvaluator::parse_number(std::string_view text) {
+    uintmax_t value = 0;
+    size_t i = 0;
+    int base = 10;
+    if (text.size() > 1 && text[0] == '0') {
+        if (text[1] == 'x' || text[1] == 'X') {
+            base = 16;
+            i = 2;
+        } else if (text[1] == 'b' || text[1] == 'B') {
+            base = 2;
+            i = 2;
+        } else {
+            base = 8;
+            i = 1;
+        }
+    }
+    for (; i < text.size(); i++) {
+        char c = text[i];
+        int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (base == 16 && c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (base == 16 && c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else if (c == '\'')
+            continue; // Digit separator
+        else
+            break;
+        if (digit >= base) {
+            fail("invalid digit in #if expression");
+            return {};
+        }
+        value = value * base + digit;
+    }
+    bool is_unsigned = false;
+    for (; i < text.size(); i++) {
+        char c = text[i];
+        if (c == 'u' || c == 'U') {
+            is_unsigned = true;
+        } else if (c != 'l' && c != 'L') {
+            fail("invalid integer suffix in #if expression");
+            return {};
+        }
+    }
+    // Values that don't fit in intmax_t are unsigned
+    if (value > static_cast<uintmax_t>(std::numeric_limits<intmax_t>::max()))
+        is_unsigned = true;
+    return { static_cast<intmax_t>(value), is_unsigned };
+}
+
+ExpressionEvaluator::Value ExpressionEvaluator::parse_character(std::string_view text) {
+    // text includes the quotes
+    auto body = text.substr(1, text.size() - 2);
+    if (body.empty()) {
+        fail("empty character constant in #if expression");
+        return {};
+    }
+    if (body[0] != '\\')
+        return { static_cast<signed char>(body[0]), false };
+    if (body.size() < 2) {
+        fail("invalid character constant in #if expression");
+        return {};
+    }
+    char c = body[1];
+    switch (c) {
+        case 'n': return { '\n', false };
+        case 't': return { '\t', false };
+        case 'r': return { '\r', false };
+        case 'a': return { '\a', false };
+        case 'b': return { '\b', false };
+        case 'f': return { '\f', false };
+        case 'v': return { '\v', false };
+        case 'x': {
+            intmax_t value = 0;
+            for (size_t i = 2; i < body.size(); i++) {
+                char h = body[i];
+                int digit = (h >= '0' && h <= '9') ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10 : (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+                if (digit == -1)
+                    break;
+                value = value * 16 + digit;
+            }
+            return { static_cast<signed char>(value), false };
+        }
+        default: {
+            if (c >= '0' && c <= '7') {
+                intmax_t value = 0;
+                for (size_t i = 1; i < body.size() && i < 4 && body[i] >= '0' && body[i] <= '7'; i++)
+                    value = value * 8 + (body[i] - '0');
+                return { static_cast<signed char>(value), false };
+            }
+            // \\, \', \", \?
+            return { c, false };
+        }
+    }
+}
+
+void ExpressionEvaluator::next() {
+    while (index_ < expression_.size() && (expression_[index_] == ' ' || expression_[index_] == '\t' || expression_[index_] == '\r'))
+        index_++;
+    if (index_ >= expression_.size()) {
+        kind_ = Kind::End;
+        text_ = {};
+        return;
+    }
+    size_t start = index_;
+    char c = expression_[index_];
+    auto peek = [&](char next) {
+        if (index_ + 1 < expression_.size() && expression_[index_ + 1] == next) {
+            index_++;
+            return true;
+        }
+        return false;
+    };
+    if (c >= '0' && c <= '9') {
+        // pp-number, validated in parse_number
+        while (index_ < expression_.size() && (DirectiveScanner::isIdentifier(expression_[index_]) || expression_[index_] == '\''))
+            index_++;
+        kind_ = Kind::Number;
+        text_ = expression_.substr(start, index_ - start);
+        return;
+    }
+    if (DirectiveScanner::isIdentifierStart(c)) {
+        while (index_ < expression_.size() && DirectiveScanner::isIdentifier(expression_[index_]))
+            index_++;
+        // A prefixed character constant such as L'a'
+        if (index_ < expression_.size() && expression_[index_] == '\'') {
+            start = index_;
+            c = '\'';
+        } else {
+            kind_ = Kind::Identifier;
+            text_ = expression_.substr(start, index_ - start);
+            return;
+        }
+    }
+    if (c == '\'') {
+        index_++;
+        while (index_ < expression_.size() && expression_[index_] != '\'') {
+            if (expression_[index_] == '\\')
+                index_++;
+            index_++;
+        }
+        if (index_ >= expression_.size()) {
+            fail("missing terminating ' in #if expression");
+            kind_ = Kind::End;
+            return;
+        }
+        index_++;
+        kind_ = Kind::Character;
+        text_ = expression_.substr(start, index_ - start);
+        return;
+    }
+    switch (c) {
+        case '(': kind_ = Kind::LeftParen; break;
+        case ')': kind_ = Kind::RightParen; break;
+        case '+': kind_ = Kind::Plus; break;
+        case '-': kind_ = Kind::Minus; break;
+        case '~': kind_ = Kind::Tilde; break;
+        case '*': kind_ = Kind::Star; break;
+        case '/': kind_ = Kind::Slash; break;
+        case '%': kind_ = Kind::Percent; break;
+        case '^': kind_ = Kind::BitXor; break;
+        case '?': kind_ = Kind::Question; break;
+        case ':': kind_ = Kind::Colon; break;
+        case ',': kind_ = Kind::Comma; break;
+        case '!': kind_ = peek('=') ? Kind::NotEqual : Kind::Not; break;
+        case '=': kind_ = peek('=') ? Kind::Equal : Kind::Invalid; break;
+        case '&': kind_ = peek('&') ? Kind::And : Kind::BitAnd; break;
+        case '|': kind_ = peek('|') ? Kind::Or : Kind::BitOr; break;
+        case '<': kind_ = peek('<') ? Kind::LeftShift : peek('=') ? Kind::LessEqual : Kind::Less; break;
+        case '>': kind_ = peek('>') ? Kind::RightShift : peek('=') ? Kind::GreaterEqual : Kind::Greater; break;
+        default: kind_ = Kind::Invalid; break;
+    }
+    index_++;
+    text_ = expression_.substr(start, index_ - start);
+}
+
+void ExpressionEvaluator::fail(std::string_view error) {
+    // Keep the first error
+    if (error_.empty())
+        error_ = error;
+}
\ No newline at end of file
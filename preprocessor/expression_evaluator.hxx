@@ -0,0 +1,72 @@
+#ifndef EXPRESSION_EVALUATOR_HXX
+#define EXPRESSION_EVALUATOR_HXX
+#include <cstdint>
+#include <string_view>
+
+// Evaluates the integer constant expression of an #if or #elif directive, after
+// `defined` was resolved and macros were expanded. Works directly on the text with
+// precedence climbing and doesn't allocate
+class ExpressionEvaluator {
+public:
+    ExpressionEvaluator(std::string_view expression) : expression_(expression) {}
+
+    // Returns false if the expression is malformed, GetError() tells why
+    bool Evaluate(bool& result);
+    std::string_view GetError() const { return error_; }
+private:
+    struct Value {
+        intmax_t value = 0;
+        bool is_unsigned = false;
+    };
+
+    enum class Kind {
+        End,
+        Number,
+        Character,
+        Identifier,
+        LeftParen,
+        RightParen,
+        Plus,
+        Minus,
+        Tilde,
+        Not,
+        Star,
+        Slash,
+        Percent,
+        LeftShift,
+        RightShift,
+        Less,
+        Greater,
+        LessEqual,
+        GreaterEqual,
+        Equal,
+        NotEqual,
+        BitAnd,
+        BitXor,
+        BitOr,
+        And,
+        Or,
+        Question,
+        Colon,
+        Comma,
+        Invalid,
+    };
+
+    Value parse_expression(int min_precedence);
+    Value parse_unary();
+    Value parse_number(std::string_view text);
+    Value parse_character(std::string_view text);
+    Value apply(Kind op, Value lhs, Value rhs);
+    void next();
+    void fail(std::string_view error);
+    static int precedence(Kind kind);
+
+    std::string_view expression_;
+    size_t index_ = 0;
+    Kind kind_ = Kind::End;
+    std::string_view text_;
+    // False inside the unevaluated operand of &&, || and ?:, where division by zero is fine
+    bool evaluating_ = true;
+    std::string_view error_;
+};
+#endif
\ No newline at end of file
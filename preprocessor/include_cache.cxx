@@ -0,0 +1,144 @@
+#include <preprocessor/include_cache.hxx>
+#include <preprocessor/directive_scanner.hxx>
+#include <preprocessor/source_cleaner.hxx>
+#include <algorithm>
+#include <cstring>
+
+SourceFile::SourceFile(std::string_view input) {
+    load(input);
+}
+
+SourceFile::SourceFile(std::shared_ptr<const SourceBuffer> buffer)
+    : buffer_(std::move(buffer))
+{
+    load(buffer_->View());
+}
+
+void SourceFile::load(std::string_view input) {
+    if (SourceCleaner::Clean(input, cleaned_))
+        text_ = cleaned_;
+    else
+        text_ = input;
+    lines_ = SourceBuffer::splitLines(text_);
+    detect_guard();
+}
+
+size_t SourceFile::NextDirectiveLine(size_t i) const {
+    if (i >= lines_.size())
+        return lines_.size();
+    const char* begin = text_.data();
+    const char* end = begin + text_.size();
+    const char* cur = lines_[i].data();
+    while (cur < end) {
+        auto hash = static_cast<const char*>(std::memchr(cur, '#', end - cur));
+        if (!hash)
+            break;
+        // Only a '#' preceded by nothing but whitespace on its line starts a directive
+        const char* start = hash;
+        while (start > cur && (start[-1] == ' ' || start[-1] == '\t'))
+            start--;
+        if (start == begin || start[-1] == '\n') {
+            auto it = std::upper_bound(lines_.begin() + i, lines_.end(), hash,
+                [](const char* ptr, std::string_view line) { return ptr < line.data(); });
+            return std::distance(lines_.begin(), it) - 1;
+        }
+        auto newline = static_cast<const char*>(std::memchr(hash, '\n', end - hash));
+        if (!newline)
+            break;
+        cur = newline + 1;
+    }
+    return lines_.size();
+}
+
+void SourceFile::detect_guard() {
+    enum { ExpectIfndef, ExpectDefine, InsideGuard, AfterEndif } state = ExpectIfndef;
+    std::string_view guard;
+    int depth = 0;
+    for (auto line : lines_) {
+        DirectiveScanner scanner(line);
+        auto directive = scanner.Scan();
+        if (directive == DirectiveType::None && scanner.AtEnd())
+            continue; // Blank line
+        switch (state) {
+            case ExpectIfndef: {
+                if (directive != DirectiveType::Ifndef)
+                    return;
+                guard = scanner.ReadIdentifier();
+                if (guard.empty() || !scanner.AtEnd())
+                    return;
+                depth = 1;
+                state = ExpectDefine;
+                break;
+            }
+            case ExpectDefine: {
+                if (directive != DirectiveType::Define || scanner.ReadIdentifier() != guard)
+                    return;
+                state = InsideGuard;
+                break;
+            }
+            case InsideGuard: {
+                switch (directive) {
+                    case DirectiveType::If:
+                    case DirectiveType::Ifdef:
+                    case DirectiveType::Ifndef: {
+                        depth++;
+                        break;
+                    }
+                    case DirectiveType::Elif:
+                    case DirectiveType::Else: {
+                        // An #else of the guard itself means the file has content when the guard is defined
+                        if (depth == 1)
+                            return;
+                        break;
+                    }
+                    case DirectiveType::Endif: {
+                        if (--depth == 0)
+                            state = AfterEndif;
+                        break;
+                    }
+                    default: break;
+                }
+                break;
+            }
+            case AfterEndif: {
+                // Anything after the closing #endif
+                return;
+            }
+        }
+    }
+    if (state == AfterEndif)
+        guard_macro_ = guard;
+}
+
+std::shared_ptr<const SourceFile> IncludeCache::Get(const std::filesystem::path& path) {
+    std::error_code error;
+    auto canonical = std::filesystem::canonical(path, error);
+    if (error)
+        return nullptr;
+    auto write_time = std::filesystem::last_write_time(canonical, error);
+    if (error)
+        return nullptr;
+    auto size = std::filesystem::file_size(canonical, error);
+    if (error)
+        return nullptr;
+    auto key = canonical.string();
+    {
+        std::lock_guard<std::mutex> lock(get_mutex());
+        auto& entries = get_entries();
+        auto it = entries.find(key);
+        if (it != entries.end() && it->second.write_time == write_time && it->second.size == size)
+            return it->second.file;
+    }
+    auto buffer = std::make_shared<const SourceBuffer>(canonical);
+    if (!buffer->IsOpen())
+        return nullptr;
+    auto file = std::make_shared<const SourceFile>(std::move(buffer));
+    std::lock_guard<std::mutex> lock(get_mutex());
+    get_entries()[key] = { write_time, size, file };
+    return file;
+}
+
+void IncludeCache::Clear() {
+    std::lock_guard<std::mutex> lock(get_mutex());
+    get_entries().clear();
+}
\ No newline at end of file
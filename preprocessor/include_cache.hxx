@@ -0,0 +1,64 @@
+#ifndef INCLUDE_CACHE_HXX
+#define INCLUDE_CACHE_HXX
+#include <common/source_buffer.hxx>
+#include <common/uncopyable.hxx>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Source text with backslash-newlines spliced and comments removed, split into lines. The text
+// is only copied when there is something to clean, otherwise the lines are views of the input
+class SourceFile : public Uncopyable {
+public:
+    // The input must outlive the SourceFile
+    SourceFile(std::string_view input);
+    // Keeps the buffer alive for as long as the SourceFile is used
+    SourceFile(std::shared_ptr<const SourceBuffer> buffer);
+
+    std::string_view Line(size_t i) const { return lines_[i]; }
+    size_t LineCount() const { return lines_.size(); }
+    std::string_view Text() const { return text_; }
+    // Index of the first line at or after i that starts with a '#', or LineCount() if there's none.
+    // Used to skip inactive conditional regions without looking at every line
+    size_t NextDirectiveLine(size_t i) const;
+    // Macro of the #ifndef X / #define X / ... / #endif guard wrapping the whole file, if any
+    const std::string& GuardMacro() const { return guard_macro_; }
+private:
+    void load(std::string_view input);
+    void detect_guard();
+
+    std::shared_ptr<const SourceBuffer> buffer_;
+    std::string cleaned_;
+    std::string_view text_;
+    std::vector<std::string_view> lines_;
+    std::string guard_macro_;
+};
+
+// Process wide cache of included files, so that headers included many times in a
+// translation unit (or by many translation units) are only read from disk once
+class IncludeCache {
+public:
+    // Returns nullptr if the file can't be read
+    static std::shared_ptr<const SourceFile> Get(const std::filesystem::path& path);
+    static void Clear();
+private:
+    struct Entry {
+        std::filesystem::file_time_type write_time;
+        std::uintmax_t size;
+        std::shared_ptr<const SourceFile> file;
+    };
+    // Keyed by canonical path
+    static std::unordered_map<std::string, Entry>& get_entries() {
+        static std::unordered_map<std::string, Entry> entries;
+        return entries;
+    }
+    static std::mutex& get_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+};
+#endif
\ No newline at end of file
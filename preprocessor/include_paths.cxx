@@ -0,0 +1,131 @@
+#include <preprocessor/include_paths.hxx>
+
+void IncludePaths::AddDirectory(const std::filesystem::path& directory, bool system) {
+    std::lock_guard<std::mutex> lock(get_mutex());
+    auto& state = get_state();
+    (system ? state.system_directories : state.directories).push_back(directory);
+    // Lookups that failed or found a file further down the list may resolve differently now
+    state.results.clear();
+}
+
+std::vector<std::filesystem::path> IncludePaths::Directories() {
+    std::lock_guard<std::mutex> lock(get_mutex());
+    const auto& state = get_state();
+    auto ret = state.directories;
+    ret.insert(ret.end(), state.system_directories.begin(), state.system_directories.end());
+    return ret;
+}
+
+void IncludePaths::Clear() {
+    std::lock_guard<std::mutex> lock(get_mutex());
+    get_state() = State();
+}
+
+std::optional<IncludePaths::Resolved> IncludePaths::Resolve(std::string_view name, bool angled, const std::filesystem::path& includer_directory) {
+    std::string key(angled ? "<" : "\"");
+    key += name;
+    // Quoted includes depend on where the includer is, angled includes don't
+    if (!angled) {
+        key += '\0';
+        key += includer_directory.string();
+    }
+    std::lock_guard<std::mutex> lock(get_mutex());
+    auto& state = get_state();
+    if (auto it = state.results.find(key); it != state.results.end())
+        return it->second;
+    auto result = resolve_impl(state, name, angled, includer_directory);
+    state.results.emplace(std::move(key), result);
+    return result;
+}
+
+std::optional<IncludePaths::Resolved> IncludePaths::resolve_impl(State& state, std::string_view name, bool angled, const std::filesystem::path& includer_directory) {
+    std::filesystem::path path(name);
+    if (path.is_absolute()) {
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(path, error))
+            return std::nullopt;
+        auto canonical = std::filesystem::canonical(path, error);
+        if (error)
+            return std::nullopt;
+        return Resolved { path, canonical.string() };
+    }
+    if (!angled) {
+        if (auto result = find_in(state, includer_directory, name))
+            return result;
+    }
+    for (const auto* directories : { &state.directories, &state.system_directories }) {
+        for (const auto& directory : *directories)
+            if (auto result = find_in(state, directory, name))
+                return result;
+    }
+    const auto& standard = get_standard_includes();
+    if (auto it = standard.find("<" + std::string(name) + ">"); it != standard.end()) {
+        std::filesystem::path standard_path(it->second);
+        if (auto result = find_in(state, standard_path.parent_path(), standard_path.filename().string()))
+            return result;
+    }
+    return find_in(state, "/usr/include", name);
+}
+
+std::optional<IncludePaths::Resolved> IncludePaths::find_in(State& state, const std::filesystem::path& directory, std::string_view name) {
+    // Walks the components of the name through the cached listings instead of calling stat
+    auto current = directory;
+    std::string_view rest = name;
+    while (true) {
+        auto slash = rest.find('/');
+        auto component = rest.substr(0, slash);
+        if (component == "..") {
+            // Going up can't be answered from the listings, unusual enough to just ask the file system
+            std::error_code error;
+            auto path = current / rest;
+            if (!std::filesystem::is_regular_file(path, error))
+                return std::nullopt;
+            break;
+        }
+        bool last = slash == std::string_view::npos;
+        if (!component.empty() && component != ".") {
+            const auto& listing = list(state, current);
+            auto it = listing.find(std::string(component));
+            if (it == listing.end() || it->second != !last)
+                return std::nullopt;
+            current /= component;
+        }
+        if (last)
+            break;
+        rest.remove_prefix(slash + 1);
+    }
+    std::error_code error;
+    auto path = directory / name;
+    auto canonical = std::filesystem::canonical(path, error);
+    if (error)
+        return std::nullopt;
+    return Resolved { path, canonical.string() };
+}
+
+const IncludePaths::Listing& IncludePaths::list(State& state, const std::filesystem::path& directory) {
+    auto key = directory.string();
+    if (auto it = state.listings.find(key); it != state.listings.end())
+        return it->second;
+    Listing listing;
+    std::error_code error;
+    // An empty directory is the one a bare relative path is in
+    auto iterated = directory.empty() ? std::filesystem::path(".") : directory;
+    // Missing directories get an empty listing, so they are not looked at again either
+    for (const auto& entry : std::filesystem::directory_iterator(iterated, error)) {
+        std::error_code type_error;
+        bool is_directory = entry.is_directory(type_error);
+        bool is_file = !is_directory && entry.is_regular_file(type_error);
+        if (!type_error && (is_directory || is_file))
+            listing.emplace(entry.path().filename().string(), is_directory);
+    }
+    return state.listings.emplace(std::move(key), std::move(listing)).first->second;
+}
+
+const std::unordered_map<std::string, std::string>& IncludePaths::get_standard_includes() {
+    static std::unordered_map<std::string, std::string> includes {
+        #define DEF(include, path) { include, path },
+        #include <preprocessor/standard_paths.txt>
+        #undef DEF
+    };
+    return includes;
+}
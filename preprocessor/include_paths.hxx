@@ -0,0 +1,55 @@
+#ifndef INCLUDE_PATHS_HXX
+#define INCLUDE_PATHS_HXX
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Ordered include search directories shared by all preprocessors. Directory listings are
+// read once and every lookup is remembered, found or not, so resolving a header only
+// touches the file system the first time it's looked up
+class IncludePaths {
+public:
+    struct Resolved {
+        // Search directory joined with the name, used for __FILE__
+        std::filesystem::path path;
+        std::string canonical;
+    };
+
+    // -I directories are searched in the order they were added, before the -isystem ones
+    static void AddDirectory(const std::filesystem::path& directory, bool system);
+    // -I directories followed by -isystem directories
+    static std::vector<std::filesystem::path> Directories();
+    // "name" is looked up next to the including file first, then like <name>, which falls
+    // back to standard_paths.txt and /usr/include after the search directories
+    static std::optional<Resolved> Resolve(std::string_view name, bool angled, const std::filesystem::path& includer_directory);
+    // Forgets the directories and everything that was cached
+    static void Clear();
+private:
+    // Entry names mapped to whether they are directories
+    using Listing = std::unordered_map<std::string, bool>;
+    struct State {
+        std::vector<std::filesystem::path> directories;
+        std::vector<std::filesystem::path> system_directories;
+        std::unordered_map<std::string, Listing> listings;
+        std::unordered_map<std::string, std::optional<Resolved>> results;
+    };
+
+    static std::optional<Resolved> resolve_impl(State& state, std::string_view name, bool angled, const std::filesystem::path& includer_directory);
+    static std::optional<Resolved> find_in(State& state, const std::filesystem::path& directory, std::string_view name);
+    static const Listing& list(State& state, const std::filesystem::path& directory);
+    static const std::unordered_map<std::string, std::string>& get_standard_includes();
+
+    static State& get_state() {
+        static State state;
+        return state;
+    }
+    static std::mutex& get_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+};
+#endif
@@ -0,0 +1,517 @@
+#include <preprocessor/macro_expander.hxx>
+#include <common/log.hxx>
+#include <algorithm>
+#include <ctime>
+
+namespace {
+    constexpr bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    constexpr bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    constexpr bool is_identifier_start(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    constexpr bool is_identifier(char c) {
+        return is_identifier_start(c) || is_digit(c);
+    }
+
+    // Returns the index after the closing quote of the literal that starts at i
+    size_t skip_literal(std::string_view text, size_t i) {
+        char quote = text[i++];
+        while (i < text.size() && text[i] != quote) {
+            if (text[i] == '\\')
+                i++;
+            i++;
+        }
+        return std::min(i + 1, text.size());
+    }
+
+    // Maximal munch over the C punctuators
+    size_t punctuator_length(std::string_view text, size_t i) {
+        constexpr std::string_view three[] = { "<<=", ">>=", "..." };
+        constexpr std::string_view two[] = {
+            "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+            "*=", "/=", "%=", "+=", "-=", "&=", "^=", "|=", "##",
+        };
+        auto rest = text.substr(i);
+        for (auto punctuator : three)
+            if (rest.starts_with(punctuator))
+                return 3;
+        for (auto punctuator : two)
+            if (rest.starts_with(punctuator))
+                return 2;
+        return 1;
+    }
+
+    bool is_punctuator(const PPToken& token, std::string_view punctuator) {
+        return token.type == PPTokenType::Punctuator && token.text == punctuator;
+    }
+
+    // Whether rhs printed right after lhs would lex differently, like -NEG giving --
+    // when NEG is -, the tokens then need a space between them
+    bool would_paste(const PPToken& lhs, const PPToken& rhs) {
+        if (lhs.text.empty() || rhs.text.empty())
+            return false;
+        char l = lhs.text.back();
+        char r = rhs.text.front();
+        switch (lhs.type) {
+            case PPTokenType::Identifier: {
+                if (r == '"' || r == '\'')
+                    return lhs.text == "L" || lhs.text == "u" || lhs.text == "U" || lhs.text == "u8";
+                return is_identifier(r);
+            }
+            case PPTokenType::Number: {
+                if ((r == '+' || r == '-') && (l == 'e' || l == 'E' || l == 'p' || l == 'P'))
+                    return true;
+                return is_identifier(r) || r == '.';
+            }
+            case PPTokenType::Punctuator: {
+                if (l == '.' && (is_digit(r) || r == '.'))
+                    return true;
+                if (l == '/' && (r == '/' || r == '*'))
+                    return true;
+                if (rhs.type != PPTokenType::Punctuator)
+                    return false;
+                std::string joined(lhs.text);
+                joined += rhs.text.substr(0, 2);
+                return punctuator_length(joined, 0) > lhs.text.size();
+            }
+            default:
+                return false;
+        }
+    }
+}
+
+MacroExpander::MacroExpander(const Defines& defines, const FuncDefines& function_defines, const MacroFilter& filter)
+    : defines_(defines)
+    , function_defines_(function_defines)
+    , filter_(filter)
+{}
+
+void MacroExpander::Tokenize(std::string_view text, std::vector<PPToken>& tokens, std::string_view* trailing) {
+    const size_t size = text.size();
+    size_t i = 0;
+    while (true) {
+        size_t whitespace_start = i;
+        while (i < size && is_space(text[i]))
+            i++;
+        auto whitespace = text.substr(whitespace_start, i - whitespace_start);
+        if (i >= size) {
+            if (trailing)
+                *trailing = whitespace;
+            return;
+        }
+        size_t start = i;
+        char c = text[i];
+        PPTokenType type = PPTokenType::Punctuator;
+        if (is_identifier_start(c)) {
+            while (i < size && is_identifier(text[i]))
+                i++;
+            type = PPTokenType::Identifier;
+            // Encoding prefixes belong to the literal that follows them
+            if (i < size && (text[i] == '"' || text[i] == '\'')) {
+                auto prefix = text.substr(start, i - start);
+                if (prefix == "L" || prefix == "u" || prefix == "U" || prefix == "u8") {
+                    type = text[i] == '"' ? PPTokenType::StringLiteral : PPTokenType::CharacterConstant;
+                    i = skip_literal(text, i);
+                }
+            }
+        } else if (is_digit(c) || (c == '.' && i + 1 < size && is_digit(text[i + 1]))) {
+            // Preprocessing numbers, includes exponents like 1e+5 and 0x1p-3
+            type = PPTokenType::Number;
+            i++;
+            while (i < size) {
+                char n = text[i];
+                char p = text[i - 1];
+                if ((n == '+' || n == '-') && (p == 'e' || p == 'E' || p == 'p' || p == 'P'))
+                    i++;
+                else if (is_identifier(n) || n == '.')
+                    i++;
+                else
+                    break;
+            }
+        } else if (c == '"' || c == '\'') {
+            type = c == '"' ? PPTokenType::StringLiteral : PPTokenType::CharacterConstant;
+            i = skip_literal(text, i);
+        } else {
+            if (c == '$' || c == '@' || c == '`' || c == '\\')
+                type = PPTokenType::Other;
+            i += punctuator_length(text, i);
+        }
+        tokens.push_back({ type, text.substr(start, i - start), whitespace });
+    }
+}
+
+MacroTemplate MacroExpander::Compile(std::vector<std::string> parameters, std::string body) {
+    MacroTemplate ret;
+    ret.arg_count = parameters.size();
+    ret.parameters = std::move(parameters);
+    ret.body = std::make_shared<const std::string>(std::move(body));
+    compile(ret, *ret.body);
+    return ret;
+}
+
+void MacroExpander::compile(MacroTemplate& ret, std::string_view body) {
+    TokenList tokens;
+    Tokenize(body, tokens);
+    auto parameter_index = [&ret](const PPToken& token) -> int {
+        if (token.type != PPTokenType::Identifier)
+            return -1;
+        auto it = std::find(ret.parameters.begin(), ret.parameters.end(), token.text);
+        return it == ret.parameters.end() ? -1 : it - ret.parameters.begin();
+    };
+    const size_t size = tokens.size();
+    bool paste = false;
+    for (size_t i = 0; i < size; i++) {
+        const auto& token = tokens[i];
+        if (is_punctuator(token, "##") && !ret.slots.empty()) {
+            paste = true;
+            continue;
+        }
+        int index;
+        if (is_punctuator(token, "#") && i + 1 < size && (index = parameter_index(tokens[i + 1])) != -1) {
+            ret.slots.push_back({ MacroSlot::Type::Stringify, paste, uint32_t(index), uint32_t(index), token.whitespace });
+            i++;
+        } else if ((index = parameter_index(token)) != -1) {
+            // Arguments on either side of ## are not macro expanded
+            bool next_is_paste = i + 1 < size && is_punctuator(tokens[i + 1], "##");
+            auto type = paste || next_is_paste ? MacroSlot::Type::RawArgument : MacroSlot::Type::Argument;
+            ret.slots.push_back({ type, paste, uint32_t(index), uint32_t(index), token.whitespace });
+        } else {
+            ret.tokens.push_back(token);
+            uint32_t end = ret.tokens.size();
+            if (!paste && !ret.slots.empty() && ret.slots.back().type == MacroSlot::Type::Literal)
+                ret.slots.back().end = end;
+            else
+                ret.slots.push_back({ MacroSlot::Type::Literal, paste, end - 1, end, {} });
+        }
+        paste = false;
+    }
+}
+
+void MacroExpander::Expand(std::string_view line, std::string& out) {
+    // Most lines don't reference any macro, those are copied without being tokenized
+    if (!may_contain_macros(line)) {
+        out += line;
+        return;
+    }
+    hide_sets_.clear();
+    hide_sets_.emplace_back();
+    storage_.clear();
+    TokenList input;
+    std::string_view trailing;
+    Tokenize(line, input, &trailing);
+    TokenList output;
+    expand(input, output);
+    for (size_t i = 0; i < output.size(); i++) {
+        const auto& token = output[i];
+        if (token.whitespace.empty() && i != 0 && would_paste(output[i - 1], token))
+            out += ' ';
+        out += token.whitespace;
+        out += token.text;
+    }
+    out += trailing;
+}
+
+bool MacroExpander::may_contain_macros(std::string_view line) const {
+    const size_t size = line.size();
+    size_t i = 0;
+    while (i < size) {
+        char c = line[i];
+        if (is_identifier_start(c)) {
+            size_t start = i;
+            while (i < size && is_identifier(line[i]))
+                i++;
+            auto name = line.substr(start, i - start);
+            if (filter_.MayContain(name) || IsBuiltin(name))
+                return true;
+        } else if (is_digit(c)) {
+            // Skip numbers so that suffixes aren't mistaken for identifiers
+            while (i < size && (is_identifier(line[i]) || line[i] == '.'))
+                i++;
+        } else if (c == '"' || c == '\'') {
+            i = skip_literal(line, i);
+        } else {
+            i++;
+        }
+    }
+    return false;
+}
+
+void MacroExpander::expand(TokenList& input, TokenList& output) {
+    // Reversed so that the expansion of a macro can be pushed in front of the remaining input cheaply
+    TokenList stack(input.rbegin(), input.rend());
+    while (!stack.empty()) {
+        PPToken token = stack.back();
+        stack.pop_back();
+        if (token.type != PPTokenType::Identifier || hide_set_contains(token.hide_set, token.text)) {
+            output.push_back(token);
+            continue;
+        }
+        TokenList expansion;
+        auto start = stats_ ? PreprocessorStats::Clock::now() : PreprocessorStats::Clock::time_point();
+        if (auto it = defines_.Find(token.text)) {
+            auto hide_set = hide_set_add(token.hide_set, it->first);
+            if (it->second.find("##") != std::string_view::npos) {
+                // Pastes go through the same template as function-like bodies. The body is only
+                // redefined by directives, so its tokens stay valid for the rest of the line
+                MacroTemplate macro;
+                compile(macro, it->second);
+                std::vector<TokenList> no_args;
+                substitute(macro, no_args, hide_set, expansion);
+            } else {
+                Tokenize(it->second, expansion);
+                for (auto& expanded : expansion)
+                    expanded.hide_set = hide_set;
+            }
+        } else if (auto fit = function_defines_.Find(token.text); fit && !stack.empty() && is_punctuator(stack.back(), "(")) {
+            const auto& macro = fit->second;
+            std::vector<TokenList> args;
+            size_t rparen;
+            if (!collect_args(stack, args, rparen)) {
+                // Invocations that don't close on the same line are left as is
+                output.push_back(token);
+                continue;
+            }
+            if (macro.arg_count == 0 && args.size() == 1 && args[0].empty())
+                args.clear();
+            if (args.size() != static_cast<size_t>(macro.arg_count)) {
+                WARN("Macro " << token.text << " expects " << macro.arg_count << " arguments, got " << args.size())
+                output.push_back(token);
+                continue;
+            }
+            auto hide_set = hide_set_add(hide_set_intersection(token.hide_set, stack[rparen].hide_set), fit->first);
+            stack.resize(rparen);
+            substitute(macro, args, hide_set, expansion);
+        } else if (auto builtin = get_builtin(token.text); builtin != Builtin::None) {
+            output.push_back(expand_builtin(builtin, token));
+            continue;
+        } else {
+            output.push_back(token);
+            continue;
+        }
+        if (stats_) {
+            auto& macro = stats_->macros[std::string(token.text)];
+            macro.expansions++;
+            macro.ns += PreprocessorStats::Elapsed(start);
+        }
+        if (!expansion.empty())
+            expansion.front().whitespace = token.whitespace;
+        else if (!stack.empty() && stack.back().whitespace.empty())
+            stack.back().whitespace = token.whitespace;
+        stack.insert(stack.end(), expansion.rbegin(), expansion.rend());
+    }
+}
+
+MacroExpander::Builtin MacroExpander::get_builtin(std::string_view name) {
+    // All built-in names are 8 characters long and start with two underscores
+    if (name.size() != 8 || name[0] != '_' || name[1] != '_')
+        return Builtin::None;
+    if (name == "__FILE__")
+        return Builtin::File;
+    if (name == "__LINE__")
+        return Builtin::Line;
+    if (name == "__DATE__")
+        return Builtin::Date;
+    if (name == "__TIME__")
+        return Builtin::Time;
+    return Builtin::None;
+}
+
+PPToken MacroExpander::expand_builtin(Builtin builtin, const PPToken& token) {
+    if ((builtin == Builtin::Date || builtin == Builtin::Time) && date_.empty()) {
+        auto time = std::time(nullptr);
+        // std::localtime isn't thread safe
+        std::tm localtime;
+        #ifdef _WIN32
+        localtime_s(&localtime, &time);
+        #else
+        localtime_r(&time, &localtime);
+        #endif
+        char buffer[32];
+        std::strftime(buffer, sizeof(buffer), "\"%b %d %Y\"", &localtime);
+        date_ = buffer;
+        std::strftime(buffer, sizeof(buffer), "\"%H:%M:%S\"", &localtime);
+        time_ = buffer;
+    }
+    switch (builtin) {
+        case Builtin::File: return { PPTokenType::StringLiteral, store("\"" + file_ + "\""), token.whitespace };
+        case Builtin::Line: return { PPTokenType::Number, store(std::to_string(line_)), token.whitespace };
+        case Builtin::Date: return { PPTokenType::StringLiteral, date_, token.whitespace };
+        case Builtin::Time: return { PPTokenType::StringLiteral, time_, token.whitespace };
+        default: return token;
+    }
+}
+
+bool MacroExpander::collect_args(TokenList& stack, std::vector<TokenList>& args, size_t& rparen) {
+    // stack.back() is the opening parenthesis
+    int depth = 0;
+    args.emplace_back();
+    for (size_t i = stack.size() - 1; i-- > 0;) {
+        const auto& token = stack[i];
+        if (is_punctuator(token, "(")) {
+            depth++;
+        } else if (is_punctuator(token, ")")) {
+            if (depth == 0) {
+                rparen = i;
+                return true;
+            }
+            depth--;
+        } else if (depth == 0 && is_punctuator(token, ",")) {
+            args.emplace_back();
+            continue;
+        }
+        args.back().push_back(token);
+    }
+    return false;
+}
+
+void MacroExpander::substitute(const MacroTemplate& macro, std::vector<TokenList>& args, size_t hide_set, TokenList& output) {
+    std::vector<TokenList> expanded_args(args.size());
+    std::vector<bool> is_expanded(args.size(), false);
+    // Whether the previous slot expanded to nothing, in which case there's nothing to paste to
+    bool placemarker = false;
+    std::string_view placemarker_whitespace;
+    for (const auto& slot : macro.slots) {
+        auto first = output.size();
+        switch (slot.type) {
+            case MacroSlot::Type::Literal: {
+                output.insert(output.end(), macro.tokens.begin() + slot.begin, macro.tokens.begin() + slot.end);
+                break;
+            }
+            case MacroSlot::Type::Argument: {
+                if (!is_expanded[slot.begin]) {
+                    expand(args[slot.begin], expanded_args[slot.begin]);
+                    is_expanded[slot.begin] = true;
+                }
+                const auto& arg = expanded_args[slot.begin];
+                output.insert(output.end(), arg.begin(), arg.end());
+                break;
+            }
+            case MacroSlot::Type::RawArgument: {
+                const auto& arg = args[slot.begin];
+                output.insert(output.end(), arg.begin(), arg.end());
+                break;
+            }
+            case MacroSlot::Type::Stringify: {
+                output.push_back(stringize(args[slot.begin], slot.whitespace));
+                break;
+            }
+        }
+        if (output.size() == first) {
+            // Pasting an empty argument to a token leaves the token as is
+            if (!slot.paste) {
+                placemarker = true;
+                placemarker_whitespace = slot.whitespace;
+            }
+            continue;
+        }
+        if (slot.type != MacroSlot::Type::Literal)
+            output[first].whitespace = slot.whitespace;
+        if (slot.paste && placemarker) {
+            output[first].whitespace = placemarker_whitespace;
+        } else if (slot.paste && first != 0) {
+            // Glue the last token before the slot with the first one of the slot
+            TokenList rest(output.begin() + first + 1, output.end());
+            auto rhs = output[first];
+            output.resize(first);
+            paste(output, rhs);
+            output.insert(output.end(), rest.begin(), rest.end());
+        }
+        placemarker = false;
+    }
+    for (auto& token : output)
+        token.hide_set = hide_set_union(token.hide_set, hide_set);
+}
+
+void MacroExpander::paste(TokenList& output, const PPToken& rhs) {
+    if (output.empty()) {
+        output.push_back(rhs);
+        return;
+    }
+    auto& lhs = output.back();
+    if (lhs.type == PPTokenType::Placemarker) {
+        lhs = { rhs.type, rhs.text, lhs.whitespace, rhs.hide_set };
+        return;
+    }
+    auto text = store(std::string(lhs.text) + std::string(rhs.text));
+    TokenList pasted;
+    Tokenize(text, pasted);
+    if (pasted.size() == 1) {
+        lhs = { pasted[0].type, text, lhs.whitespace, lhs.hide_set };
+    } else {
+        WARN("Pasting \"" << lhs.text << "\" and \"" << rhs.text << "\" does not give a valid preprocessing token")
+        output.push_back(rhs);
+    }
+}
+
+PPToken MacroExpander::stringize(const TokenList& arg, std::string_view whitespace) {
+    std::string str = "\"";
+    for (size_t i = 0; i < arg.size(); i++) {
+        const auto& token = arg[i];
+        if (i != 0 && !token.whitespace.empty())
+            str += ' ';
+        if (token.type == PPTokenType::StringLiteral || token.type == PPTokenType::CharacterConstant) {
+            for (char c : token.text) {
+                if (c == '"' || c == '\\')
+                    str += '\\';
+                str += c;
+            }
+        } else {
+            str += token.text;
+        }
+    }
+    str += '"';
+    return { PPTokenType::StringLiteral, store(std::move(str)), whitespace };
+}
+
+std::string_view MacroExpander::store(std::string str) {
+    return storage_.emplace_back(std::move(str));
+}
+
+size_t MacroExpander::hide_set_add(size_t set, std::string_view name) {
+    if (hide_set_contains(set, name))
+        return set;
+    auto names = hide_sets_[set];
+    names.push_back(name);
+    hide_sets_.push_back(std::move(names));
+    return hide_sets_.size() - 1;
+}
+
+size_t MacroExpander::hide_set_union(size_t lhs, size_t rhs) {
+    if (lhs == rhs || rhs == 0)
+        return lhs;
+    if (lhs == 0)
+        return rhs;
+    auto ret = lhs;
+    // Copy since hide_set_add can reallocate the pool
+    auto names = hide_sets_[rhs];
+    for (auto name : names)
+        ret = hide_set_add(ret, name);
+    return ret;
+}
+
+size_t MacroExpander::hide_set_intersection(size_t lhs, size_t rhs) {
+    if (lhs == rhs)
+        return lhs;
+    if (lhs == 0 || rhs == 0)
+        return 0;
+    std::vector<std::string_view> names;
+    for (auto name : hide_sets_[lhs])
+        if (hide_set_contains(rhs, name))
+            names.push_back(name);
+    if (names.empty())
+        return 0;
+    hide_sets_.push_back(std::move(names));
+    return hide_sets_.size() - 1;
+}
+
+bool MacroExpander::hide_set_contains(size_t set, std::string_view name) {
+    const auto& names = hide_sets_[set];
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef MACRO_EXPANDER_HXX
+#define MACRO_EXPANDER_HXX
+#include <preprocessor/defines.hxx>
+#include <preprocessor/macro_filter.hxx>
+#include <preprocessor/preprocessor_stats.hxx>
+#include <common/uncopyable.hxx>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Expands object-like and function-like macros in a line using Prosser's hide set
+// algorithm, which handles recursion, stringification (#) and token pasting (##)
+class MacroExpander : public Uncopyable {
+public:
+    // The filter must contain the names of all the defines and function defines
+    MacroExpander(const Defines& defines, const FuncDefines& function_defines, const MacroFilter& filter);
+
+    // Appends the expanded line to out
+    void Expand(std::string_view line, std::string& out);
+
+    // Splits text into preprocessing tokens, whitespace at the end of the text is returned in trailing
+    static void Tokenize(std::string_view text, std::vector<PPToken>& tokens, std::string_view* trailing = nullptr);
+
+    // Location that __FILE__ and __LINE__ expand to
+    void SetFile(std::string file) { file_ = std::move(file); }
+    void SetLine(size_t line) { line_ = line; }
+    // Counts expansions per macro while set
+    void SetStats(PreprocessorStats* stats) { stats_ = stats; }
+
+    // __FILE__, __LINE__, __DATE__ and __TIME__, expanded by the expander itself
+    static bool IsBuiltin(std::string_view name) { return get_builtin(name) != Builtin::None; }
+    // Output that depends on when it was produced can't be cached
+    bool ExpandedDateOrTime() const { return !date_.empty(); }
+
+    // Precompiles the body of a function-like macro into literal runs and argument slots
+    static MacroTemplate Compile(std::vector<std::string> parameters, std::string body);
+private:
+    // Fills in the tokens and slots of the template, which point into body
+    static void compile(MacroTemplate& macro, std::string_view body);
+    using TokenList = std::vector<PPToken>;
+    enum class Builtin { None, File, Line, Date, Time };
+
+    static Builtin get_builtin(std::string_view name);
+    bool may_contain_macros(std::string_view line) const;
+    PPToken expand_builtin(Builtin builtin, const PPToken& token);
+    void expand(TokenList& input, TokenList& output);
+    bool collect_args(TokenList& stack, std::vector<TokenList>& args, size_t& rparen);
+    void substitute(const MacroTemplate& macro, std::vector<TokenList>& args, size_t hide_set, TokenList& output);
+    void paste(TokenList& output, const PPToken& rhs);
+    PPToken stringize(const TokenList& arg, std::string_view whitespace);
+    std::string_view store(std::string str);
+
+    size_t hide_set_add(size_t set, std::string_view name);
+    size_t hide_set_union(size_t lhs, size_t rhs);
+    size_t hide_set_intersection(size_t lhs, size_t rhs);
+    bool hide_set_contains(size_t set, std::string_view name);
+
+    const Defines& defines_;
+    const FuncDefines& function_defines_;
+    const MacroFilter& filter_;
+    std::vector<std::vector<std::string_view>> hide_sets_;
+    // Owns the text of tokens created during expansion, deque keeps the views stable
+    std::deque<std::string> storage_;
+    std::string file_;
+    size_t line_ = 0;
+    PreprocessorStats* stats_ = nullptr;
+    // Computed once, when first used
+    std::string date_;
+    std::string time_;
+};
+#endif
\ No newline at end of file
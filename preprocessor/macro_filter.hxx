@@ -0,0 +1,67 @@
+#ifndef MACRO_FILTER_HXX
+#define MACRO_FILTER_HXX
+#include <common/str_hash.hxx>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Bloom filter over the names of the defined macros. Lets the expander tell that
+// a line references no macros without looking up every identifier. Removing a name
+// can't clear its bits, so removals are only counted and the owner rebuilds the
+// filter once too many of the set bits are stale
+class MacroFilter {
+public:
+    MacroFilter() { Reset(0); }
+
+    // Clears the filter, sized for the given number of names
+    void Reset(size_t expected_count) {
+        size_t bits = min_bits;
+        while (bits < expected_count * bits_per_name)
+            bits *= 2;
+        bits_.assign(bits / 64, 0);
+        mask_ = bits - 1;
+        count_ = 0;
+        removed_ = 0;
+    }
+
+    void Add(std::string_view name) {
+        auto hash = hash64(name);
+        set(hash);
+        set(hash >> 32);
+        count_++;
+    }
+
+    void Remove(std::string_view) {
+        removed_++;
+    }
+
+    bool MayContain(std::string_view name) const {
+        auto hash = hash64(name);
+        return test(hash) && test(hash >> 32);
+    }
+
+    // Whether the filter became too full or too stale to be useful, see Reset
+    bool NeedsRebuild() const {
+        return count_ * bits_per_name > bits_.size() * 64 || (removed_ > 64 && removed_ * 2 > count_);
+    }
+private:
+    void set(uint64_t hash) {
+        auto bit = hash & mask_;
+        bits_[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+
+    bool test(uint64_t hash) const {
+        auto bit = hash & mask_;
+        return bits_[bit / 64] & (uint64_t(1) << (bit % 64));
+    }
+
+    static constexpr size_t min_bits = 4096;
+    // Around 1.5% false positives with two hashes when the filter is as full as it gets
+    static constexpr size_t bits_per_name = 16;
+
+    std::vector<uint64_t> bits_;
+    uint64_t mask_ = 0;
+    size_t count_ = 0;
+    size_t removed_ = 0;
+};
+#endif
\ No newline at end of file
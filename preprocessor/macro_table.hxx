@@ -0,0 +1,231 @@
+#ifndef MACRO_TABLE_HXX
+#define MACRO_TABLE_HXX
+#include <common/str_hash.hxx>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for strings that live as long as the table that owns it
+class StringArena {
+public:
+    StringArena() = default;
+    StringArena(StringArena&&) = default;
+    StringArena& operator=(StringArena&&) = default;
+
+    std::string_view Store(std::string_view str) {
+        if (str.empty())
+            return {};
+        if (str.size() > remaining_) {
+            size_t size = std::max(chunk_size, str.size());
+            chunks_.push_back(std::make_unique<char[]>(size));
+            current_ = chunks_.back().get();
+            remaining_ = size;
+        }
+        std::memcpy(current_, str.data(), str.size());
+        std::string_view ret(current_, str.size());
+        current_ += str.size();
+        remaining_ -= str.size();
+        return ret;
+    }
+
+    // Overwrites old, which has to be stored in this arena, when str fits in it
+    std::string_view Replace(std::string_view old, std::string_view str) {
+        if (str.size() > old.size())
+            return Store(str);
+        if (str.empty())
+            return {};
+        std::memmove(const_cast<char*>(old.data()), str.data(), str.size());
+        return old.substr(0, str.size());
+    }
+private:
+    static constexpr size_t chunk_size = 64 * 1024;
+    // The chunks don't move when the arena does, so views stay valid
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* current_ = nullptr;
+    size_t remaining_ = 0;
+};
+
+// Open addressing hash table of macros keyed by name. Names, and bodies when the value
+// is a std::string_view, are stored in an arena so defining a macro doesn't allocate a
+// node per entry. Erased entries are left as tombstones until the next rehash, and their
+// strings are overwritten by the next macro stored in the slot when it fits
+template <typename Value>
+class MacroTable {
+public:
+    // Pair-like so that entries can be used like std::unordered_map ones
+    struct Entry {
+        std::string_view first;
+        Value second;
+    };
+
+    MacroTable() = default;
+
+    MacroTable(MacroTable&& other) {
+        *this = std::move(other);
+    }
+
+    MacroTable& operator=(MacroTable&& other) {
+        slots_ = std::move(other.slots_);
+        arena_ = std::move(other.arena_);
+        mask_ = std::exchange(other.mask_, 0);
+        size_ = std::exchange(other.size_, 0);
+        tombstones_ = std::exchange(other.tombstones_, 0);
+        other.slots_.clear();
+        return *this;
+    }
+
+    // Copies store the strings in their own arena
+    MacroTable(const MacroTable& other) {
+        *this = other;
+    }
+
+    MacroTable& operator=(const MacroTable& other) {
+        if (this == &other)
+            return *this;
+        MacroTable copy;
+        copy.reserve(other.size_);
+        for (const auto& [name, value] : other)
+            copy.Insert(name, value);
+        *this = std::move(copy);
+        return *this;
+    }
+
+    Entry* Find(std::string_view name) {
+        auto index = find_slot(name);
+        return index == npos ? nullptr : &slots_[index].entry;
+    }
+
+    const Entry* Find(std::string_view name) const {
+        auto index = find_slot(name);
+        return index == npos ? nullptr : &slots_[index].entry;
+    }
+
+    bool Contains(std::string_view name) const {
+        return Find(name) != nullptr;
+    }
+
+    // Inserts the macro or replaces the value of an existing one
+    Value& Insert(std::string_view name, Value value) {
+        if (auto entry = Find(name)) {
+            entry->second = store_value(entry->second, std::move(value));
+            return entry->second;
+        }
+        if ((size_ + tombstones_ + 1) * 4 > slots_.size() * 3)
+            reserve(size_ + 1);
+        auto hash = hash64(name);
+        size_t i = hash & mask_;
+        while (slots_[i].state == State::Live)
+            i = (i + 1) & mask_;
+        auto& slot = slots_[i];
+        if (slot.state == State::Tombstone)
+            tombstones_--;
+        slot.hash = hash;
+        slot.state = State::Live;
+        slot.entry.first = arena_.Replace(slot.entry.first, name);
+        slot.entry.second = store_value(slot.entry.second, std::move(value));
+        size_++;
+        return slot.entry.second;
+    }
+
+    bool Erase(std::string_view name) {
+        auto index = find_slot(name);
+        if (index == npos)
+            return false;
+        auto& slot = slots_[index];
+        slot.state = State::Tombstone;
+        // A string_view body stays for the next macro in the slot to reuse its space
+        if constexpr (!std::is_same_v<Value, std::string_view>)
+            slot.entry.second = Value();
+        size_--;
+        tombstones_++;
+        return true;
+    }
+
+    size_t Size() const { return size_; }
+
+    template <typename Table, typename EntryType>
+    class Iterator {
+    public:
+        Iterator(Table* table, size_t index) : table_(table), index_(index) { skip(); }
+        EntryType& operator*() const { return table_->slots_[index_].entry; }
+        EntryType* operator->() const { return &table_->slots_[index_].entry; }
+        Iterator& operator++() { index_++; skip(); return *this; }
+        bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+        bool operator==(const Iterator& other) const { return index_ == other.index_; }
+    private:
+        void skip() {
+            while (index_ < table_->slots_.size() && table_->slots_[index_].state != State::Live)
+                index_++;
+        }
+        Table* table_;
+        size_t index_;
+    };
+
+    auto begin() { return Iterator<MacroTable, Entry>(this, 0); }
+    auto end() { return Iterator<MacroTable, Entry>(this, slots_.size()); }
+    auto begin() const { return Iterator<const MacroTable, const Entry>(this, 0); }
+    auto end() const { return Iterator<const MacroTable, const Entry>(this, slots_.size()); }
+private:
+    enum class State : uint8_t { Empty, Live, Tombstone };
+
+    struct Slot {
+        uint64_t hash = 0;
+        State state = State::Empty;
+        Entry entry;
+    };
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    // string_view bodies are copied into the arena, over the old body when they fit
+    Value store_value(const Value& old, Value value) {
+        if constexpr (std::is_same_v<Value, std::string_view>)
+            return arena_.Replace(old, value);
+        else
+            return value;
+    }
+
+    size_t find_slot(std::string_view name) const {
+        if (size_ == 0)
+            return npos;
+        auto hash = hash64(name);
+        // Linear probing, there's always an empty slot since the load factor is kept under 3/4
+        for (size_t i = hash & mask_;; i = (i + 1) & mask_) {
+            const auto& slot = slots_[i];
+            if (slot.state == State::Empty)
+                return npos;
+            if (slot.state == State::Live && slot.hash == hash && slot.entry.first == name)
+                return i;
+        }
+    }
+
+    // Rehashes into a table that fits count live entries at half load, dropping the tombstones
+    void reserve(size_t count) {
+        size_t capacity = 16;
+        while (capacity < count * 2)
+            capacity *= 2;
+        std::vector<Slot> old(capacity);
+        old.swap(slots_);
+        mask_ = capacity - 1;
+        tombstones_ = 0;
+        for (auto& slot : old) {
+            if (slot.state != State::Live)
+                continue;
+            size_t i = slot.hash & mask_;
+            while (slots_[i].state == State::Live)
+                i = (i + 1) & mask_;
+            slots_[i] = std::move(slot);
+        }
+    }
+
+    std::vector<Slot> slots_;
+    size_t mask_ = 0;
+    size_t size_ = 0;
+    size_t tombstones_ = 0;
+    StringArena arena_;
+};
+#endif
\ No newline at end of file
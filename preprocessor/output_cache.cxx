@@ -0,0 +1,166 @@
+#include <preprocessor/output_cache.hxx>
+#include <common/source_buffer.hxx>
+#include <common/str_hash.hxx>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+namespace {
+    constexpr char cache_magic[4] = { 'C', 'P', 'P', 'C' };
+    constexpr uint32_t cache_version = 3;
+
+    std::filesystem::path entry_path(const std::filesystem::path& directory, uint64_t key) {
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+        return directory / name;
+    }
+
+    // Hash of the file contents, nullopt if the file can't be read
+    std::optional<uint64_t> hash_file(const std::filesystem::path& path) {
+        SourceBuffer buffer(path);
+        if (!buffer.IsOpen())
+            return std::nullopt;
+        return xxhash64(buffer.View());
+    }
+
+    // Reads from the mapped file, any read past the end sets failed
+    struct CacheReader {
+        std::string_view data;
+        size_t index = 0;
+        bool failed = false;
+
+        std::string_view bytes(uint64_t size) {
+            if (failed || index + size > data.size()) {
+                failed = true;
+                return {};
+            }
+            auto ret = data.substr(index, size);
+            index += size;
+            return ret;
+        }
+        uint32_t u32() { uint32_t ret = 0; if (auto b = bytes(sizeof(ret)); !failed) std::memcpy(&ret, b.data(), sizeof(ret)); return ret; }
+        uint64_t u64() { uint64_t ret = 0; if (auto b = bytes(sizeof(ret)); !failed) std::memcpy(&ret, b.data(), sizeof(ret)); return ret; }
+        std::string_view str() { return bytes(u32()); }
+    };
+
+    struct CacheWriter {
+        std::ofstream& ofs;
+        void u32(uint32_t value) { ofs.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+        void u64(uint64_t value) { ofs.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+        void str(std::string_view str) { u32(str.size()); ofs.write(str.data(), str.size()); }
+    };
+}
+
+bool OutputCache::Lookup(const std::filesystem::path& directory, uint64_t key, std::string& data) {
+    auto path = entry_path(directory, key);
+    {
+        SourceBuffer buffer(path);
+        if (!buffer.IsOpen())
+            return false;
+        CacheReader reader { buffer.View() };
+        auto magic = reader.bytes(sizeof(cache_magic));
+        if (reader.failed || std::memcmp(magic.data(), cache_magic, sizeof(cache_magic)) != 0)
+            return false;
+        if (reader.u32() != cache_version)
+            return false;
+        auto include_count = reader.u32();
+        for (uint32_t i = 0; i < include_count && !reader.failed; i++) {
+            auto include = reader.str();
+            auto hash = reader.u64();
+            if (reader.failed || hash_file(std::string(include)) != hash)
+                return false;
+        }
+        auto size = reader.u64();
+        auto cached = reader.bytes(size);
+        if (reader.failed)
+            return false;
+        data.assign(cached);
+    }
+    // Used entries are the last to be evicted
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    return true;
+}
+
+void OutputCache::Store(const std::filesystem::path& directory, uint64_t key, std::string_view data,
+    const std::vector<std::string>& includes, uint64_t max_size)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    auto path = entry_path(directory, key);
+    // Written under a name unique to the thread and renamed, so that readers never see a partial entry
+    std::stringstream tmp_name;
+    tmp_name << path.filename().string() << ".tmp" << std::this_thread::get_id();
+    auto tmp_path = directory / tmp_name.str();
+    {
+        std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open())
+            return;
+        CacheWriter writer { ofs };
+        ofs.write(cache_magic, sizeof(cache_magic));
+        writer.u32(cache_version);
+        writer.u32(includes.size());
+        for (const auto& include : includes) {
+            auto hash = hash_file(include);
+            if (!hash) {
+                ofs.close();
+                std::filesystem::remove(tmp_path, error);
+                return;
+            }
+            writer.str(include);
+            writer.u64(*hash);
+        }
+        writer.u64(data.size());
+        ofs.write(data.data(), data.size());
+        if (!ofs.good()) {
+            ofs.close();
+            std::filesystem::remove(tmp_path, error);
+            return;
+        }
+    }
+    std::filesystem::rename(tmp_path, path, error);
+    if (error) {
+        std::filesystem::remove(tmp_path, error);
+        return;
+    }
+    evict(directory, max_size);
+}
+
+void OutputCache::evict(const std::filesystem::path& directory, uint64_t max_size) {
+    // Threads storing at the same time would otherwise evict the same entries
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    struct Entry {
+        std::filesystem::file_time_type time;
+        uint64_t size;
+        std::filesystem::path path;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code error;
+    for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+        if (!file.is_regular_file(error))
+            continue;
+        Entry entry { file.last_write_time(error), file.file_size(error), file.path() };
+        if (error)
+            continue;
+        total += entry.size;
+        entries.push_back(std::move(entry));
+    }
+    if (total <= max_size)
+        return;
+    // Going a bit below the limit so that a full cache doesn't evict on every store
+    const uint64_t target = max_size / 10 * 9;
+    std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) { return lhs.time < rhs.time; });
+    for (const auto& entry : entries) {
+        if (total <= target)
+            break;
+        if (std::filesystem::remove(entry.path, error))
+            total -= entry.size;
+    }
+}
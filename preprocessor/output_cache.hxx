@@ -0,0 +1,22 @@
+#ifndef OUTPUT_CACHE_HXX
+#define OUTPUT_CACHE_HXX
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Persistent cache of preprocessed output, one file per entry named after the key.
+// The key covers everything the output depends on except the included files, whose
+// contents are hashed into the entry and checked again on lookup. The cached data is
+// opaque, the preprocessor stores its final state along with the output
+struct OutputCache {
+    // Returns false if there's no entry or one of the files it included has changed
+    static bool Lookup(const std::filesystem::path& directory, uint64_t key, std::string& data);
+    // Evicts the least recently used entries if the directory grows past max_size bytes
+    static void Store(const std::filesystem::path& directory, uint64_t key, std::string_view data,
+        const std::vector<std::string>& includes, uint64_t max_size);
+private:
+    static void evict(const std::filesystem::path& directory, uint64_t max_size);
+};
+#endif
@@ -0,0 +1,109 @@
+#ifndef OUTPUT_SINK_HXX
+#define OUTPUT_SINK_HXX
+#include <common/uncopyable.hxx>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Receives the preprocessed text as it's produced, so it doesn't have to be kept
+// in memory as a whole. Chunks are only valid for the duration of the call
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+    virtual void Write(std::string_view chunk) = 0;
+    // File and line the next chunk starts at, for sinks that map the output back to the source
+    virtual void SetLocation(std::string_view, size_t) {}
+};
+
+// Discards everything
+class NullSink : public OutputSink {
+public:
+    void Write(std::string_view) override {}
+};
+
+// Appends everything to a string
+class StringSink : public OutputSink {
+public:
+    StringSink(std::string& out) : out_(out) {}
+    void Write(std::string_view chunk) override { out_ += chunk; }
+private:
+    std::string& out_;
+};
+
+// A SetLocation call, at an offset into the output
+struct OutputLocation {
+    size_t offset;
+    std::string_view file;
+    size_t line;
+};
+
+// Passes everything on to another sink while appending it to a string. Locations are
+// recorded as offsets into the string, except those that follow on from the previous one
+class TeeSink : public OutputSink, public Uncopyable {
+public:
+    TeeSink(std::string& out, OutputSink& next) : out_(out), next_(next) {}
+    void Write(std::string_view chunk) override {
+        out_ += chunk;
+        lines_ += std::count(chunk.begin(), chunk.end(), '\n');
+        next_.Write(chunk);
+    }
+    void SetLocation(std::string_view file, size_t line) override {
+        next_.SetLocation(file, line);
+        if (!locations_.empty()) {
+            auto& last = locations_.back();
+            if (last.file == file && last.line + (lines_ - last_lines_) == line)
+                return;
+            if (last.offset == out_.size())
+                locations_.pop_back();
+        }
+        locations_.push_back({ out_.size(), *files_.emplace(file).first, line });
+        last_lines_ = lines_;
+    }
+    const std::vector<OutputLocation>& Locations() const { return locations_; }
+private:
+    std::string& out_;
+    OutputSink& next_;
+    // Node based, so the locations can point into it
+    std::unordered_set<std::string> files_;
+    std::vector<OutputLocation> locations_;
+    size_t lines_ = 0;
+    // Lines written before the last recorded location
+    size_t last_lines_ = 0;
+};
+
+class CallbackSink : public OutputSink {
+public:
+    CallbackSink(std::function<void(std::string_view)> callback) : callback_(std::move(callback)) {}
+    void Write(std::string_view chunk) override { callback_(chunk); }
+private:
+    std::function<void(std::string_view)> callback_;
+};
+
+// Buffered writes to a file, or to an already open stream such as stdout
+class FileSink : public OutputSink, public Uncopyable {
+public:
+    // IsOpen() is false if the file couldn't be created
+    FileSink(const std::filesystem::path& path) : file_(std::fopen(path.string().c_str(), "wb")), owned_(true) {}
+    FileSink(std::FILE* file) : file_(file), owned_(false) {}
+    ~FileSink() {
+        if (file_ && owned_)
+            std::fclose(file_);
+        else if (file_)
+            std::fflush(file_);
+    }
+
+    bool IsOpen() const { return file_ != nullptr; }
+    void Write(std::string_view chunk) override {
+        if (file_)
+            std::fwrite(chunk.data(), 1, chunk.size(), file_);
+    }
+private:
+    std::FILE* file_;
+    bool owned_;
+};
+#endif
\ No newline at end of file
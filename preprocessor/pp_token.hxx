@@ -0,0 +1,23 @@
+#ifndef PP_TOKEN_HXX
+#define PP_TOKEN_HXX
+#include <string_view>
+
+enum class PPTokenType {
+    Identifier,
+    Number,
+    StringLiteral,
+    CharacterConstant,
+    Punctuator,
+    Placemarker, // Empty argument next to a ## operator
+    Other,
+};
+
+struct PPToken {
+    PPTokenType type;
+    std::string_view text;
+    // Whitespace that precedes the token in the output
+    std::string_view whitespace;
+    // Index of the hide set in the expander's hide set pool, 0 is the empty set
+    size_t hide_set = 0;
+};
+#endif
\ No newline at end of file
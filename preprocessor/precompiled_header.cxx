@@ -0,0 +1,186 @@
+#include <preprocessor/precompiled_header.hxx>
+#include <preprocessor/preprocessor.hxx>
+#include <preprocessor/macro_expander.hxx>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    constexpr char pch_magic[4] = { 'C', 'P', 'C', 'H' };
+    constexpr uint32_t pch_version = 2;
+
+    struct PchWriter {
+        std::string& out;
+        void u32(uint32_t value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+        void u64(uint64_t value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+        void str(std::string_view str) { u32(str.size()); out.append(str); }
+    };
+
+    // Reads from the mapped file, any read past the end sets failed
+    struct PchReader {
+        std::string_view data;
+        size_t index = 0;
+        bool failed = false;
+
+        bool read(void* out, size_t size) {
+            if (failed || index + size > data.size()) {
+                failed = true;
+                return false;
+            }
+            std::memcpy(out, data.data() + index, size);
+            index += size;
+            return true;
+        }
+        uint32_t u32() { uint32_t ret = 0; read(&ret, sizeof(ret)); return ret; }
+        uint64_t u64() { uint64_t ret = 0; read(&ret, sizeof(ret)); return ret; }
+        // Count of the elements that follow, each at least min_size bytes long. Counts that
+        // can't fit in the rest of the data fail before anything is allocated for them
+        uint32_t count(size_t min_size) {
+            auto ret = u32();
+            if (failed || ret > (data.size() - index) / min_size) {
+                failed = true;
+                return 0;
+            }
+            return ret;
+        }
+        std::string_view str() { return bytes(u32()); }
+        std::string_view bytes(uint64_t size) {
+            if (failed || index + size > data.size()) {
+                failed = true;
+                return {};
+            }
+            auto ret = data.substr(index, size);
+            index += size;
+            return ret;
+        }
+    };
+}
+
+bool PrecompiledHeader::Save(const std::filesystem::path& path, const Preprocessor& preprocessor, std::string_view output) {
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open())
+        return false;
+    std::string header;
+    header.append(pch_magic, sizeof(pch_magic));
+    PchWriter { header }.u32(pch_version);
+    ofs.write(header.data(), header.size());
+    auto data = Serialize(preprocessor, output);
+    ofs.write(data.data(), data.size());
+    return ofs.good();
+}
+
+std::string PrecompiledHeader::Serialize(const Preprocessor& preprocessor, std::string_view output,
+    const std::vector<OutputLocation>& locations) {
+    std::string data;
+    PchWriter writer { data };
+    const auto& defines = preprocessor.GetDefines();
+    writer.u32(defines.Size());
+    for (const auto& [key, value] : defines) {
+        writer.str(key);
+        writer.str(value);
+    }
+    const auto& function_defines = preprocessor.GetFunctionDefines();
+    writer.u32(function_defines.Size());
+    for (const auto& [key, macro] : function_defines) {
+        writer.str(key);
+        writer.u32(macro.parameters.size());
+        for (const auto& parameter : macro.parameters)
+            writer.str(parameter);
+        writer.str(*macro.body);
+    }
+    const auto& include_guards = preprocessor.GetIncludeGuards();
+    writer.u32(include_guards.size());
+    for (const auto& [path, guard] : include_guards) {
+        writer.str(path);
+        writer.str(guard);
+    }
+    const auto& pragma_once_files = preprocessor.GetPragmaOnceFiles();
+    writer.u32(pragma_once_files.size());
+    for (const auto& path : pragma_once_files)
+        writer.str(path);
+    writer.u64(output.size());
+    data.append(output);
+    writer.u32(locations.size());
+    for (const auto& location : locations) {
+        writer.u64(location.offset);
+        writer.str(location.file);
+        writer.u64(location.line);
+    }
+    return data;
+}
+
+std::shared_ptr<const PrecompiledHeader> PrecompiledHeader::Load(const std::filesystem::path& path) {
+    std::lock_guard<std::mutex> lock(get_mutex());
+    auto& loaded = get_loaded();
+    auto key = path.string();
+    if (auto it = loaded.find(key); it != loaded.end())
+        return it->second;
+    auto buffer = std::make_shared<const SourceBuffer>(path);
+    if (!buffer->IsOpen())
+        return nullptr;
+    auto pch = std::make_shared<PrecompiledHeader>();
+    pch->buffer_ = buffer;
+    PchReader reader { buffer->View() };
+    char magic[sizeof(pch_magic)];
+    if (!reader.read(magic, sizeof(magic)) || std::memcmp(magic, pch_magic, sizeof(magic)) != 0)
+        return nullptr;
+    if (reader.u32() != pch_version)
+        return nullptr;
+    if (!Deserialize(buffer->View().substr(reader.index), *pch))
+        return nullptr;
+    loaded[key] = pch;
+    return pch;
+}
+
+bool PrecompiledHeader::Deserialize(std::string_view data, PrecompiledHeader& pch) {
+    PchReader reader { data };
+    auto define_count = reader.count(2 * sizeof(uint32_t));
+    for (uint32_t i = 0; i < define_count && !reader.failed; i++) {
+        auto key = reader.str();
+        auto value = reader.str();
+        pch.defines.Insert(key, value);
+    }
+    auto function_count = reader.count(3 * sizeof(uint32_t));
+    for (uint32_t i = 0; i < function_count && !reader.failed; i++) {
+        auto key = reader.str();
+        std::vector<std::string> parameters(reader.count(sizeof(uint32_t)));
+        for (auto& parameter : parameters)
+            parameter = reader.str();
+        auto body = reader.str();
+        pch.function_defines.Insert(key, MacroExpander::Compile(std::move(parameters), std::string(body)));
+    }
+    auto guard_count = reader.count(2 * sizeof(uint32_t));
+    for (uint32_t i = 0; i < guard_count && !reader.failed; i++) {
+        auto path = reader.str();
+        auto guard = reader.str();
+        pch.include_guards.emplace(path, guard);
+    }
+    auto once_count = reader.count(sizeof(uint32_t));
+    for (uint32_t i = 0; i < once_count && !reader.failed; i++)
+        pch.pragma_once_files.emplace(reader.str());
+    pch.output = reader.bytes(reader.u64());
+    auto location_count = reader.count(2 * sizeof(uint64_t) + sizeof(uint32_t));
+    pch.locations.reserve(location_count);
+    size_t previous = 0;
+    for (uint32_t i = 0; i < location_count && !reader.failed; i++) {
+        auto offset = reader.u64();
+        auto file = reader.str();
+        auto line = reader.u64();
+        if (offset < previous || offset > pch.output.size())
+            return false;
+        pch.locations.push_back({ offset, file, line });
+        previous = offset;
+    }
+    return !reader.failed;
+}
+
+void PrecompiledHeader::Write(OutputSink& sink) const {
+    size_t offset = 0;
+    for (const auto& location : locations) {
+        if (location.offset != offset)
+            sink.Write(output.substr(offset, location.offset - offset));
+        sink.SetLocation(location.file, location.line);
+        offset = location.offset;
+    }
+    sink.Write(output.substr(offset));
+}
\ No newline at end of file
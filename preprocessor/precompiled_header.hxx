@@ -0,0 +1,51 @@
+#ifndef PRECOMPILED_HEADER_HXX
+#define PRECOMPILED_HEADER_HXX
+#include <preprocessor/defines.hxx>
+#include <preprocessor/output_sink.hxx>
+#include <common/source_buffer.hxx>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class Preprocessor;
+
+// Snapshot of the preprocessor state after processing a header, stored in a compact
+// binary file so that later compilations can start from it instead of reprocessing
+struct PrecompiledHeader {
+    Defines defines;
+    FuncDefines function_defines;
+    std::unordered_map<std::string, std::string> include_guards;
+    std::unordered_set<std::string> pragma_once_files;
+    // Expanded output of the header, points into the mapped file
+    std::string_view output;
+    // Where the output came from, if it was recorded. Sorted by offset
+    std::vector<OutputLocation> locations;
+
+    static bool Save(const std::filesystem::path& path, const Preprocessor& preprocessor, std::string_view output);
+    // Loaded files are kept for the rest of the run, returns nullptr if the file is invalid
+    static std::shared_ptr<const PrecompiledHeader> Load(const std::filesystem::path& path);
+    // The state and output without the file header, which the output cache stores too
+    static std::string Serialize(const Preprocessor& preprocessor, std::string_view output,
+        const std::vector<OutputLocation>& locations = {});
+    // The output and locations point into data, returns false if data is invalid
+    static bool Deserialize(std::string_view data, PrecompiledHeader& pch);
+    // Writes the output to the sink, setting the recorded locations along the way
+    void Write(OutputSink& sink) const;
+private:
+    std::shared_ptr<const SourceBuffer> buffer_;
+
+    static std::unordered_map<std::string, std::shared_ptr<const PrecompiledHeader>>& get_loaded() {
+        static std::unordered_map<std::string, std::shared_ptr<const PrecompiledHeader>> loaded;
+        return loaded;
+    }
+    static std::mutex& get_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+};
+#endif
\ No newline at end of file
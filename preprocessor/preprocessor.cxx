@@ -1,29 +1,42 @@
 #include <preprocessor/preprocessor.hxx>
-#include <boolean_evaluator/boolean_evaluator.hxx>
+#include <preprocessor/directive_scanner.hxx>
+#include <preprocessor/include_cache.hxx>
+#include <preprocessor/precompiled_header.hxx>
+#include <preprocessor/expression_evaluator.hxx>
+#include <preprocessor/output_cache.hxx>
 #include <common/log.hxx>
 #include <common/global.hxx>
-#include <regex>
+#include <common/str_hash.hxx>
 #include <iostream>
-#include <iomanip>
-#include <ctime>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 
-constexpr auto word_start = R"!!(([\W]|^))!!";
-constexpr auto word_end = R"!!(([\W]|$))!!";
+Preprocessor::Preprocessor(std::string_view input)
+    : Preprocessor(input, Global::GetCurrentPath())
+{}
 
-Preprocessor::Preprocessor(const std::string& input)
+Preprocessor::Preprocessor(std::string_view input, std::filesystem::path path)
     : input_(input)
-    , first_file_path_(Global::GetCurrentPath())
-{}
+    , first_file_path_(std::move(path))
+    , expander_(defines_, function_defines_, macro_filter_)
+{
+    if (!Global::GetStatsFormat().empty()) {
+        stats_ = std::make_unique<PreprocessorStats>();
+        expander_.SetStats(stats_.get());
+    }
+}
 
 Preprocessor::~Preprocessor() {
+    if (stats_)
+        PreprocessorStats::Accumulate(*stats_);
+    std::lock_guard<std::mutex> lock(getLatestMutex());
     getLatestDefines() = std::move(defines_);
     getLatestFunctionDefines() = std::move(function_defines_);
 }
 
 void Preprocessor::dumpDefines() {
+    std::lock_guard<std::mutex> lock(getLatestMutex());
     dump_defines_impl(getLatestDefines(), getLatestFunctionDefines());
 }
 
@@ -32,224 +45,385 @@ void Preprocessor::DumpDefines() {
 }
 
 void Preprocessor::dump_defines_impl(const Defines& defines, const FuncDefines& function_defines) {
-    if (defines.size() == 0 && function_defines.size() == 0)
+    if (defines.Size() == 0 && function_defines.Size() == 0)
         std::cout << "No defines to dump :(" << std::endl;
     else {
-        if (defines.size() != 0) {
+        if (defines.Size() != 0) {
             std::cout << "Dumping defines: " << std::endl;
             for (const auto& [key, value] : defines) {
                 std::cout << key << ": " << value << std::endl;
             }
         }
-        if (function_defines.size() != 0) {
+        if (function_defines.Size() != 0) {
             std::cout << "Dumping function defines: " << std::endl;
-            for (const auto& [key, tuple] : function_defines) {
-                const auto& [arg_count, value] = tuple;
+            for (const auto& [key, macro] : function_defines) {
                 std::cout << key << "(";
-                for (int i = 0; i < arg_count; i++) {
-                    std::cout << "$" << i + 2;
-                    if (i != arg_count - 1)
+                for (int i = 0; i < macro.arg_count; i++) {
+                    std::cout << macro.parameters[i];
+                    if (i != macro.arg_count - 1)
                         std::cout << ", ";
                 }
-                std::cout << ")" << ": " << value << ")" << std::endl;
+                std::cout << ")" << ": " << *macro.body << std::endl;
             }
         }
     }
 }
 
 std::string Preprocessor::Process() {
+    std::string output;
+    StringSink sink(output);
+    Process(sink);
+    return output;
+}
+
+std::vector<std::string> Preprocessor::ScanDependencies() {
+    directives_only_ = true;
+    NullSink sink;
+    Process(sink);
+    return std::move(dependencies_);
+}
+
+void Preprocessor::Process(OutputSink& sink) {
     if (IsError())
-        return "";
-    initialize_defines();
-    std::string ret = input_;
+        return;
+    if (Global::GetCacheDir().empty() || directives_only_) {
+        sink_ = &sink;
+        initialize_state();
+        process_main();
+        return;
+    }
+    // The output is only known to be cacheable once it's complete, so a copy is collected
+    // along with the locations, which a hit sets again
+    std::string output;
+    TeeSink capture(output, sink);
+    sink_ = &capture;
+    // Nothing is written before process_main, the cache key needs the initial macros
+    initialize_state();
+    auto key = cache_key();
+    // Entries hold the state at the end of the file too, for -dd, IsDefined and precompiled headers
+    std::string data;
+    if (OutputCache::Lookup(Global::GetCacheDir(), key, data)) {
+        PrecompiledHeader cached;
+        if (PrecompiledHeader::Deserialize(data, cached)) {
+            restore_state(cached);
+            cache_hit_ = true;
+            cached.Write(sink);
+            return;
+        }
+    }
+    process_main();
+    if (!expander_.ExpandedDateOrTime()) {
+        OutputCache::Store(Global::GetCacheDir(), key, PrecompiledHeader::Serialize(*this, output, capture.Locations()),
+            dependencies_, Global::GetCacheSize());
+    }
+}
+
+void Preprocessor::initialize_state() {
     current_path_ = std::filesystem::path(first_file_path_);
-    process_impl(ret, first_file_path_);
-    return out_stream_.str();
+    if (!Global::GetPchPath().empty())
+        load_precompiled_header(Global::GetPchPath());
+    else
+        initialize_defines();
+}
+
+void Preprocessor::process_main() {
+    if (precompiled_header_) {
+        // Same as if the header was included at the start of the file
+        sink_->SetLocation(Global::GetPchPath(), 1);
+        sink_->Write(precompiled_header_->output);
+        sink_->Write("\n");
+    }
+    SourceFile file(input_);
+    PreprocessorStats::FileScope scope(stats_.get(), first_file_path_.string(), input_.size());
+    process_impl(file, first_file_path_);
+    // Record the guard of the main file too, so a precompiled header made from it
+    // knows to skip the header when it's included again
+    std::error_code error;
+    auto canonical = std::filesystem::canonical(first_file_path_, error);
+    if (!error && !file.GuardMacro().empty())
+        include_guards_[canonical.string()] = file.GuardMacro();
+}
+
+uint64_t Preprocessor::cache_key() const {
+    // The included files are not known yet, the cache entry checks those
+    std::string state;
+    auto append = [&state](uint64_t value) { state.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    state += first_file_path_.string();
+    state += '\0';
+    state += Global::GetDebug() ? '1' : '0';
+    state += Global::GetPchPath();
+    state += '\0';
+    for (const auto& directory : IncludePaths::Directories()) {
+        state += directory.string();
+        state += '\0';
+    }
+    append(xxhash64(input_));
+    // Summed so that the order of the table doesn't matter
+    uint64_t defines = 0;
+    for (const auto& [key, value] : defines_)
+        defines += xxhash64(value, xxhash64(key));
+    append(defines);
+    uint64_t function_defines = 0;
+    for (const auto& [key, macro] : function_defines_) {
+        uint64_t hash = xxhash64(*macro.body, xxhash64(key));
+        for (const auto& parameter : macro.parameters)
+            hash = xxhash64(parameter, hash);
+        function_defines += hash;
+    }
+    append(function_defines);
+    return xxhash64(state);
 }
 
 bool Preprocessor::IsDefined(const std::string& macro) {
-    return defines_.find(macro) != defines_.end();
+    return defines_.Contains(macro);
 }
 
-std::string Preprocessor::remove_comments(const std::string& input) {
-    using index = std::string::size_type;
-    std::string ret;
-    ret.reserve(input.size());
-    bool is_string = false;
-    bool is_comment = false;
-    bool is_multiline = false;
-    bool first_star = false;
-    bool first_slash = false;
-    for (index i = 0; i < input.size(); i++)
-    {
-        switch (input[i])
-        {
-            case '/': {
-                if (!is_string) {
-                    if (is_multiline && first_star) {
-                        is_multiline = false;
-                        first_star = false;
-                    } else if (!first_slash) {
-                        is_comment = true;
-                        first_slash = false;
-                    }
-                    else
-                        first_slash = true;
+void Preprocessor::process_impl(const SourceFile& file, std::filesystem::path current_path) {
+    current_path_ = current_path;
+    current_file_ = current_path_.string();
+    expander_.SetFile(current_file_);
+    const size_t line_count = file.LineCount();
+    // Conditionals can't span files, so every file gets its own stack
+    std::vector<Conditional> conditionals;
+    size_t i = 0;
+    while (i < line_count) {
+        bool active = conditionals.empty() || conditionals.back().active;
+        if (!active || directives_only_) {
+            // Only directives matter inside an inactive region or when scanning for dependencies
+            auto from = i;
+            i = file.NextDirectiveLine(i);
+            if (stats_ && !active)
+                stats_->Current().lines_skipped += i - from;
+            if (i == line_count)
+                break;
+        }
+        current_line_ = i + 1; // 1-based
+        auto line = file.Line(i++);
+        bool last = i == line_count;
+        DirectiveScanner scanner(line);
+        auto directive = scanner.Scan();
+        if (!active && !DirectiveScanner::isConditional(directive)) {
+            if (stats_)
+                stats_->Current().lines_skipped++;
+            continue;
+        }
+        // Included files are timed on their own
+        bool timed = stats_ && directive != DirectiveType::None && directive != DirectiveType::Include;
+        auto start = timed ? PreprocessorStats::Clock::now() : PreprocessorStats::Clock::time_point();
+        switch (directive) {
+            case DirectiveType::None: {
+                line_buffer_.assign(line);
+                replace_macros(line_buffer_);
+                if (!last)
+                    line_buffer_ += '\n';
+                sink_->SetLocation(current_file_, current_line_);
+                sink_->Write(line_buffer_);
+                if (stats_)
+                    stats_->Current().lines_emitted++;
+                break;
+            }
+            case DirectiveType::Define: {
+                auto name = scanner.ReadIdentifier();
+                if (name.empty())
+                    throw_error(PreprocessorError::Placeholder, "macro name missing");
+                std::string_view params;
+                // Function-like macros have the parenthesis immediately after the name
+                if (scanner.Consume('(')) {
+                    if (!scanner.ReadUntil(')', params))
+                        throw_error(PreprocessorError::Placeholder, "missing ')' in macro parameter list");
+                    define_function(name, handle_args(params), std::string(scanner.Rest()));
+                } else {
+                    define(name, scanner.Rest());
                 }
                 break;
             }
-            case '*': {
-                if (!is_string) {
-                    if (!is_multiline && first_slash && !is_comment) {
-                        is_multiline = true;
-                        first_slash = false;
-                    } else if (is_multiline) {
-                        first_star = true;
-                    }
+            case DirectiveType::Undef: {
+                auto name = scanner.ReadIdentifier();
+                if (undefine(name) && macro_filter_.NeedsRebuild())
+                    rebuild_macro_filter();
+                break;
+            }
+            case DirectiveType::Error: {
+                throw_error(PreprocessorError::Directive, std::string(scanner.Rest()));
+                break;
+            }
+            case DirectiveType::If: {
+                bool value = active && evaluate(scanner.Rest());
+                // Inside an inactive region every branch counts as taken, so none becomes active
+                conditionals.push_back({ value, !active || value });
+                break;
+            }
+            case DirectiveType::Ifdef:
+            case DirectiveType::Ifndef: {
+                bool value = false;
+                if (active) {
+                    bool defined = is_macro(scanner.ReadIdentifier());
+                    value = directive == DirectiveType::Ifdef ? defined : !defined;
+                }
+                conditionals.push_back({ value, !active || value });
+                break;
+            }
+            case DirectiveType::Elif: {
+                if (conditionals.empty() || conditionals.back().seen_else)
+                    throw_error(PreprocessorError::Conditional, "#elif without #if");
+                auto& conditional = conditionals.back();
+                if (conditional.taken) {
+                    conditional.active = false;
+                } else {
+                    conditional.active = evaluate(scanner.Rest());
+                    conditional.taken = conditional.active;
                 }
                 break;
             }
-            case '"': {
-                if (!is_comment && !is_multiline)
-                    is_string ^= true;
-                [[fallthrough]];
+            case DirectiveType::Else: {
+                if (conditionals.empty() || conditionals.back().seen_else)
+                    throw_error(PreprocessorError::Conditional, "#else without #if");
+                auto& conditional = conditionals.back();
+                conditional.active = !conditional.taken;
+                conditional.taken = true;
+                conditional.seen_else = true;
+                break;
+            }
+            case DirectiveType::Endif: {
+                if (conditionals.empty())
+                    throw_error(PreprocessorError::Conditional, "#endif without #if");
+                conditionals.pop_back();
+                break;
+            }
+            case DirectiveType::Include: {
+                std::string_view name;
+                bool angled = false;
+                scanner.SkipWhitespace();
+                if (scanner.Consume('<') && scanner.ReadUntil('>', name)) {
+                    // #include <...>
+                    angled = true;
+                } else if (!(scanner.Consume('"') && scanner.ReadUntil('"', name))) {
+                    WARN("Ignoring malformed #include: " << line)
+                    break;
+                }
+                auto include = IncludePaths::Resolve(name, angled, current_path.parent_path());
+                if (!include)
+                    throw_error(PreprocessorError::IncludeNotFound, std::string(name));
+                include_impl(*include);
+                break;
+            }
+            case DirectiveType::Pragma: {
+                if (scanner.ReadIdentifier() == "once") {
+                    std::error_code error;
+                    auto canonical = std::filesystem::canonical(current_path, error);
+                    if (!error)
+                        pragma_once_files_.insert(canonical.string());
+                }
+                break;
             }
             default: {
-                if (!is_comment && !is_multiline)
-                    ret += input[i];
-                first_star = false;
-                first_slash = false;
+                // Null directive, unsupported or unknown directives are dropped
                 break;
             }
         }
+        if (timed)
+            stats_->Current().directive_ns += PreprocessorStats::Elapsed(start);
     }
-    return ret;
+    if (!conditionals.empty())
+        throw_error(PreprocessorError::Conditional, "unterminated conditional directive");
 }
 
-void Preprocessor::process_impl(const std::string& input, std::filesystem::path current_path) {
-    std::string copy = input;
-    remove_unnecessary(copy);
-    current_path_ = current_path;
-    std::vector<std::string> lines;
-    std::stringstream stream(copy);
-    std::string line;
-    while (std::getline(stream, line))
-        lines.push_back(line);
-
-    static std::regex define_function_regex(R"!!(^[ \t]*#[ \t]*define[ \t]+([A-Za-z_][A-Za-z_0-9]*)[ \t]*\((.+?)\)[ \t]*(.*)$)!!");
-    static std::regex define_regex(R"!(^[ \t]*#[ \t]*define[ \t]+([A-Za-z_][A-Za-z_0-9]*)[ \t]*(.*)$)!");
-    static std::regex error_regex(R"(^[ \t]*#[ \t]*error[ \t]+(.+)$)");
-    static std::regex undef_regex(R"(^[ \t]*#[ \t]*undef[ \t]+([A-Za-z_][A-Za-z_0-9]*)[ \t]*$)");
-    static std::regex ifdef_regex(R"(^[ \t]*#[ \t]*ifdef[ \t]+([A-Za-z_][A-Za-z_0-9]*)[ \t]*$)");
-    static std::regex ifndef_regex(R"(^[ \t]*#[ \t]*ifndef[ \t]+([A-Za-z_][A-Za-z_0-9]*)[ \t]*$)");
-    static std::regex if_regex(R"!(^[ \t]*#[ \t]*if[ \t]+(.*)$)!");
-    static std::regex endif_regex(R"(^[ \t]*#[ \t]*endif[ \t]*$)");
-    static std::regex include_regex_angle(R"(^[ \t]*#[ \t]*include[ \t]+<([A-Za-z0-9_/\.]+)>[ \t]*$)");
-    static std::regex include_regex_quote(R"!!(^[ \t]*#[ \t]*include[ \t]+"([A-Za-z0-9_/\.]+)"[ \t]*$)!!");
+bool Preprocessor::evaluate(std::string_view expression) {
+    // `defined` is resolved first, otherwise the macro names it checks would be expanded
+    expression_buffer_.clear();
+    replace_defined(expression, expression_buffer_);
+    expanded_expression_buffer_.clear();
+    expander_.SetLine(current_line_);
+    expander_.Expand(expression_buffer_, expanded_expression_buffer_);
+    ExpressionEvaluator evaluator(expanded_expression_buffer_);
+    bool result = false;
+    if (!evaluator.Evaluate(result))
+        throw_error(PreprocessorError::Expression, std::string(evaluator.GetError()));
+    return result;
+}
 
-    bool conditional = true;
+void Preprocessor::replace_defined(std::string_view expression, std::string& out) {
     size_t i = 0;
-    while (i < lines.size()) {
-        current_line_ = i + 1; // 1-based
-        auto line = lines[i++];
-        bool last = i == lines.size();
-        if (conditional) {
-            if (std::find(line.begin(), line.end(), '#') != line.end()) {
-                // Handle lines that contain '#'
-                std::smatch match;
-                if (std::regex_match(line, match, define_function_regex)) {
-                    // #define some_func()
-                    std::string args = match[3];
-                    int count = handle_args(match[2], args);
-                    define_function(match[1], count, args);
-                } else if (std::regex_match(line, match, define_regex)) {
-                    // #define
-                    define(match[1], match[2]);
-                } else if (std::regex_match(line, match, error_regex)) {
-                    // #error
-                    throw_error(PreprocessorError::Directive, match[1]);
-                } else if (std::regex_match(line, match, if_regex)) {
-                    // #if
-                    std::string unprocessed_expr = match[1];
-                    auto expr = simplify_expression(unprocessed_expr);
-                    conditional = BooleanEvaluator::Evaluate(expr);
-                } else if (std::regex_match(line, match, undef_regex)) {
-                    // #undef
-                    defines_.erase(match[1]);
-                    function_defines_.erase(match[1]);
-                } else if (std::regex_match(line, match, ifdef_regex)) {
-                    // #ifdef
-                    conditional = (defines_.find(match[1]) != defines_.end());
-                } else if (std::regex_match(line, match, ifndef_regex)) {
-                    // #ifndef
-                    conditional = (defines_.find(match[1]) == defines_.end());
-                } else if (std::regex_match(line, match, include_regex_angle)) {
-                    // #include <...>
-                    std::filesystem::path path(std::string("/usr/include/") + match[1].str());
-                    include_impl(lines, path, i);
-                } else if (std::regex_match(line, match, include_regex_quote)) {
-                    // #include "..."
-                    std::filesystem::path temppath(match[1].str());
-                    std::filesystem::path path;
-                    if (temppath.is_relative())
-                        path = std::filesystem::path(current_path.parent_path().string() + "/" + match[1].str());
-                    else
-                        path = temppath;
-                    include_impl(lines, path, i);
-                }
-            } else {
-                replace_predefined_macros(line);
-                replace_macros(line);
-                out_stream_ << line;
-                if (!last)
-                    out_stream_ << "\n";
+    while (i < expression.size()) {
+        char c = expression[i];
+        size_t start = i;
+        if (c == '\'' || c == '"') {
+            // Copy literals as they are so their contents aren't mistaken for identifiers
+            i++;
+            while (i < expression.size() && expression[i] != c) {
+                if (expression[i] == '\\')
+                    i++;
+                i++;
             }
-        } else {
-            std::smatch match;
-            if (std::regex_match(line, match, endif_regex)) {
-                conditional = true;
+            i = std::min(i + 1, expression.size());
+            out.append(expression.substr(start, i - start));
+        } else if (DirectiveScanner::isIdentifier(c)) {
+            while (i < expression.size() && DirectiveScanner::isIdentifier(expression[i]))
+                i++;
+            auto identifier = expression.substr(start, i - start);
+            if (identifier != "defined") {
+                out.append(identifier);
+                continue;
+            }
+            // defined X or defined ( X )
+            DirectiveScanner scanner(expression.substr(i));
+            scanner.SkipWhitespace();
+            bool paren = scanner.Consume('(');
+            auto name = scanner.ReadIdentifier();
+            if (name.empty())
+                throw_error(PreprocessorError::Expression, "macro name missing after defined");
+            if (paren) {
+                scanner.SkipWhitespace();
+                if (!scanner.Consume(')'))
+                    throw_error(PreprocessorError::Expression, "missing ')' after defined");
             }
+            out += is_macro(name) ? '1' : '0';
+            i += scanner.Position();
+        } else {
+            out += c;
+            i++;
         }
     }
 }
 
-std::string Preprocessor::simplify_expression(const std::string& expression) {
-    std::string ret = expression;
-    std::string prefix = R"!(defined[ \t]*[\( ][ \t]*)!";
-    std::string suffix = R"!([ \t]*[\) ])!";
-    for (const auto& [key, _] : defines_) {
-        std::regex regex(prefix + key + suffix);
-        ret = std::regex_replace(ret, regex, "T");
-    }
-    for (const auto& [key, _] : function_defines_) {
-        std::regex regex(prefix + key + suffix);
-        ret = std::regex_replace(ret, regex, "T");
-    }
-    std::regex regex(prefix + "(.+?)" + suffix);
-    ret = std::regex_replace(ret, regex, "F");
-    // Remove spaces
-    ret = std::regex_replace(ret, std::regex("[ \t]"), "");
-    // Replace && with & and || with |
-    ret = std::regex_replace(ret, std::regex(R"(\|\|)"), "|");
-    ret = std::regex_replace(ret, std::regex(R"(&&)"), "&");
-    return ret;
+bool Preprocessor::is_macro(std::string_view name) const {
+    return defines_.Contains(name) || function_defines_.Contains(name) || MacroExpander::IsBuiltin(name);
 }
 
-size_t Preprocessor::include_impl(std::vector<std::string>& lines, std::filesystem::path path, size_t i) {
+void Preprocessor::include_impl(const IncludePaths::Resolved& include) {
     current_include_depth_++;
     if (current_include_depth_ > Global::GetMaxIncludeDepth())
         throw_error(PreprocessorError::IncludeDepth);
-    if (!std::filesystem::is_regular_file(path))
+    const auto& canonical = include.canonical;
+    if (dependency_set_.insert(canonical).second)
+        dependencies_.push_back(canonical);
+    // Skip files that we know would expand to nothing without opening them
+    bool skip = pragma_once_files_.contains(canonical);
+    if (auto it = include_guards_.find(canonical); it != include_guards_.end())
+        skip = skip || IsDefined(it->second);
+    if (skip) {
+        if (stats_)
+            stats_->files[canonical].skipped_includes++;
+        sink_->Write("\n");
+        current_include_depth_--;
+        return;
+    }
+    auto file = IncludeCache::Get(canonical);
+    if (!file)
         throw_error(PreprocessorError::IncludeNotFound);
-    std::ifstream file(path);
-    std::stringstream ss;
-    ss << file.rdbuf();
-    std::string unprocessed_src = ss.str();
+    if (!file->GuardMacro().empty())
+        include_guards_[canonical] = file->GuardMacro();
     // Processing current included file
-    process_impl(unprocessed_src, path);
-    out_stream_ << '\n';
+    auto includer_path = current_path_;
+    {
+        PreprocessorStats::FileScope scope(stats_.get(), canonical, file->Text().size());
+        process_impl(*file, include.path);
+    }
+    current_path_ = includer_path;
+    current_file_ = current_path_.string();
+    expander_.SetFile(current_file_);
+    sink_->Write("\n");
     current_include_depth_--;
-    return 0;
 }
 
 void Preprocessor::throw_error(PreprocessorError error, std::string message) {
@@ -262,6 +436,8 @@ void Preprocessor::throw_error(PreprocessorError error, std::string message) {
         }
         case PreprocessorError::IncludeNotFound: {
             ss << "File not found";
+            if (!message.empty())
+                ss << ": " << message;
             break;
         }
         case PreprocessorError::Directive: {
@@ -280,80 +456,67 @@ void Preprocessor::throw_error(PreprocessorError error, std::string message) {
     throw std::runtime_error(error_message);
 }
 
-void Preprocessor::remove_unnecessary(std::string& input) {
-    input = std::regex_replace(input, std::regex(R"(\\\n)"), "");
+void Preprocessor::replace_macros(std::string& line) {
+    std::string expanded;
+    expanded.reserve(line.size());
+    expander_.SetLine(current_line_);
+    if (stats_) {
+        auto start = PreprocessorStats::Clock::now();
+        expander_.Expand(line, expanded);
+        stats_->Current().expansion_ns += PreprocessorStats::Elapsed(start);
+    } else {
+        expander_.Expand(line, expanded);
+    }
+    line.swap(expanded);
 }
 
-void Preprocessor::replace_predefined_macros(std::string& line) {
-    static std::regex date_regex(R"!!(([\W]|^)(__DATE__)([\W]|$))!!");
-    static std::regex time_regex(R"!!(([\W]|^)(__TIME__)([\W]|$))!!");
-    static std::regex file_regex(R"!!(([\W]|^)(__FILE__)([\W]|$))!!");
-    static std::regex line_regex(R"!!(([\W]|^)(__LINE__)([\W]|$))!!");
-    auto time = std::time(nullptr);
-    auto localtime = *std::localtime(&time);
-    std::stringstream sdate;
-    sdate << "$01" << '"' << std::put_time(&localtime, "%b %d %Y") << '"' << "$03";
-    std::stringstream stime;
-    stime << "$01" << '"' << std::put_time(&localtime, "%H:%M:%S") << '"' << "$03";
-    std::string sline = std::string("$01") + std::to_string(current_line_) + std::string("$03");
-    std::string sfile = std::string("$01\"") + current_path_.string() + std::string("\"$03");
-    line = std::regex_replace(line, date_regex, sdate.str());
-    line = std::regex_replace(line, time_regex, stime.str());
-    line = std::regex_replace(line, file_regex, sfile);
-    line = std::regex_replace(line, line_regex, sline);
+void Preprocessor::define(std::string_view key, std::string_view value) {
+    if (defines_.Contains(key))
+        WARN(key << " redefinition")
+    else
+        add_to_macro_filter(key);
+    defines_.Insert(key, value);
 }
 
-void Preprocessor::replace_macros(std::string& line) {
-    bool any_replaced = true;
-    while (any_replaced) {
-        any_replaced = false;
-        for (const auto& [key, value] : defines_) {
-            auto regex = std::regex(word_start + key + word_end);
-            if (std::regex_search(line, regex)) {
-                any_replaced = true;
-                line = std::regex_replace(line, regex, std::string("$01") + value + std::string("$02"));
-            }
-        }
-        const std::string spacing_opt = R"!!([ \t]*)!!";
-        const std::string word = R"!!((.+?))!!";
-        for (const auto& [key, tuple] : function_defines_) {
-            const auto& [arg_count, value] = tuple;
-            // Build the regex to replace the function
-            std::stringstream regex_builder;
-            regex_builder << word_start << key;
-            regex_builder << spacing_opt << "\\(" << spacing_opt;
-            for (int i = 0; i < arg_count; i++) {
-                regex_builder << word << spacing_opt;
-                if (i != arg_count - 1)
-                    regex_builder << "," << spacing_opt;
-            }
-            regex_builder << "\\)";
-            auto regex = std::regex(regex_builder.str());
-            if (std::regex_search(line, regex)) {
-                any_replaced = true;
-                // TODO: make it not need $1? aka whatever character was before the function_macro
-                line = std::regex_replace(line, regex, std::string("$01") + value);
-            }
-        }
+void Preprocessor::define_function(std::string_view key, std::vector<std::string> parameters, std::string value) {
+    if (function_defines_.Contains(key))
+        WARN(key << " function redefinition")
+    else
+        add_to_macro_filter(key);
+    function_defines_.Insert(key, MacroExpander::Compile(std::move(parameters), std::move(value)));
+}
+
+bool Preprocessor::undefine(std::string_view name) {
+    bool erased = false;
+    if (defines_.Erase(name)) {
+        macro_filter_.Remove(name);
+        erased = true;
     }
+    if (function_defines_.Erase(name)) {
+        macro_filter_.Remove(name);
+        erased = true;
+    }
+    return erased;
 }
 
-void Preprocessor::define(std::string key, std::string value) {
-    if (defines_.find(key) != defines_.end())
-        WARN(key << " redefinition")
-    defines_[key] = value;
+void Preprocessor::add_to_macro_filter(std::string_view name) {
+    macro_filter_.Add(name);
+    if (macro_filter_.NeedsRebuild())
+        rebuild_macro_filter();
 }
 
-void Preprocessor::define_function(std::string key, int arg_count, std::string value) {
-    if (function_defines_.find(key) != function_defines_.end())
-        WARN(key << " function redefinition")
-    function_defines_[key] = { arg_count, value };
+void Preprocessor::rebuild_macro_filter() {
+    macro_filter_.Reset(defines_.Size() + function_defines_.Size());
+    for (const auto& [key, _] : defines_)
+        macro_filter_.Add(key);
+    for (const auto& [key, _] : function_defines_)
+        macro_filter_.Add(key);
 }
 
-int Preprocessor::handle_args(const std::string& args, std::string& value) {
+std::vector<std::string> Preprocessor::handle_args(std::string_view args) {
     std::vector<std::string> arg_split;
     std::string cur_arg;
-    for (int i = 0; i < args.size(); i++) {
+    for (size_t i = 0; i < args.size(); i++) {
         switch (args[i]) {
             case ',': {
                 if (std::find(arg_split.begin(), arg_split.end(), cur_arg) != arg_split.end()) {
@@ -373,17 +536,10 @@ int Preprocessor::handle_args(const std::string& args, std::string& value) {
             }
         }
     }
-    arg_split.push_back(cur_arg);
-
-    int i = 1;
-    for (const auto& arg : arg_split) {
-        // TODO: handle #arg and ##arg and args inside quotes
-        auto regex_string = word_start + std::string("(") + arg + ")" + std::string(word_end);
-        std::regex regex(regex_string);
-        value = std::regex_replace(value, regex, "$1$$" + std::to_string(i + 1) + "$3");
-        ++i;
-    }
-    return arg_split.size();
+    // A macro declared with empty parenthesis takes no arguments
+    if (!cur_arg.empty() || !arg_split.empty())
+        arg_split.push_back(cur_arg);
+    return arg_split;
 }
 
 void Preprocessor::initialize_defines() {
@@ -393,11 +549,22 @@ void Preprocessor::initialize_defines() {
     define("__STDC__", "1");
 }
 
-const std::unordered_map<std::string, std::string>& Preprocessor::get_standard_includes() {
-    static std::unordered_map<std::string, std::string> includes {
-        #define DEF(include, path) { include, path },
-        #include <preprocessor/standard_paths.txt>
-        #undef DEF
-    };
-    return includes;
+void Preprocessor::restore_state(const PrecompiledHeader& pch) {
+    defines_ = pch.defines;
+    function_defines_ = pch.function_defines;
+    include_guards_ = pch.include_guards;
+    pragma_once_files_ = pch.pragma_once_files;
+    rebuild_macro_filter();
+}
+
+void Preprocessor::load_precompiled_header(const std::filesystem::path& path) {
+    auto pch = PrecompiledHeader::Load(path);
+    if (!pch)
+        throw_error(PreprocessorError::Placeholder, "invalid precompiled header: " + path.string());
+    restore_state(*pch);
+    std::error_code error;
+    auto canonical = std::filesystem::canonical(path, error);
+    if (!error && dependency_set_.insert(canonical.string()).second)
+        dependencies_.push_back(canonical.string());
+    precompiled_header_ = std::move(pch);
 }
\ No newline at end of file
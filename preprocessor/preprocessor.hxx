@@ -1,58 +1,120 @@
 #ifndef PREPROCESSOR_HXX
 #define PREPROCESSOR_HXX
 #include <preprocessor/preprocessor_error.hxx>
+#include <preprocessor/macro_expander.hxx>
+#include <preprocessor/macro_filter.hxx>
+#include <preprocessor/include_cache.hxx>
+#include <preprocessor/include_paths.hxx>
+#include <preprocessor/output_sink.hxx>
+#include <preprocessor/preprocessor_stats.hxx>
 #include <common/uncopyable.hxx>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <vector>
 #include <string>
 #include <filesystem>
 #include <unordered_map>
+#include <unordered_set>
 
-using Defines = std::unordered_map<std::string, std::string>;
-using FuncDefines = std::unordered_map<std::string, std::tuple<int, std::string>>;
+struct PrecompiledHeader;
 
 class Preprocessor : public Uncopyable {
 public:
-    Preprocessor(const std::string& input);
+    // Uses Global::GetCurrentPath() as the path of the input
+    Preprocessor(std::string_view input);
+    Preprocessor(std::string_view input, std::filesystem::path path);
     ~Preprocessor();
 
     std::string Process();
+    // Streams the output to the sink as it's produced instead of returning it. If
+    // Global::GetCacheDir() is set the output is looked up in and stored to the cache,
+    // on a hit nothing is processed and the state at the end of the file is restored
+    void Process(OutputSink& sink);
+    // Only evaluates directives, skipping all other lines without expanding them, and returns
+    // the canonical paths of the included files in the order they are first included
+    std::vector<std::string> ScanDependencies();
     // Check if macro is defined at the end of processing, useful for testing
     bool IsDefined(const std::string&);
+    // Check if the output came from the cache, useful for testing
+    bool IsCacheHit() const { return cache_hit_; }
     bool IsError() { return current_error_.has_value(); }
     PreprocessorError GetError() { return *current_error_; }
-    const auto& GetDefines() { return defines_; }
-    const auto& GetFunctionDefines() { return function_defines_; }
+    const auto& GetDefines() const { return defines_; }
+    const auto& GetFunctionDefines() const { return function_defines_; }
+    const auto& GetIncludeGuards() const { return include_guards_; }
+    const auto& GetPragmaOnceFiles() const { return pragma_once_files_; }
     void DumpDefines();
 
     // Dumps latest preprocessor defines, to be used after a preprocessor instance is destructed
     static void dumpDefines();
 private:
-    std::string remove_comments(const std::string& input);
-    void process_impl(const std::string& input, std::filesystem::path current_path);
-    size_t include_impl(std::vector<std::string>& lines, std::filesystem::path path, size_t i);
-    void remove_unnecessary(std::string&);
-    void replace_predefined_macros(std::string&);
+    struct Conditional {
+        // Whether lines in the current branch are processed
+        bool active;
+        // Whether a branch of this conditional was already taken, later branches are skipped
+        bool taken;
+        bool seen_else = false;
+    };
+
+    void process_impl(const SourceFile& file, std::filesystem::path current_path);
+    void include_impl(const IncludePaths::Resolved& include);
+    void initialize_state();
+    void process_main();
+    uint64_t cache_key() const;
     void replace_macros(std::string&);
     void throw_error(PreprocessorError error, std::string message = "");
-    void define(std::string key, std::string value = "");
-    void define_function(std::string key, int args, std::string value);
-    int handle_args(const std::string& args, std::string& value);
+    void define(std::string_view key, std::string_view value = "");
+    void define_function(std::string_view key, std::vector<std::string> parameters, std::string value);
+    bool undefine(std::string_view name);
+    void add_to_macro_filter(std::string_view name);
+    void rebuild_macro_filter();
+    std::vector<std::string> handle_args(std::string_view args);
     void initialize_defines();
-    std::string simplify_expression(const std::string&);
+    // Macros, include guards and #pragma once files
+    void restore_state(const PrecompiledHeader& pch);
+    void load_precompiled_header(const std::filesystem::path& path);
+    bool evaluate(std::string_view expression);
+    void replace_defined(std::string_view expression, std::string& out);
+    bool is_macro(std::string_view name) const;
     static void dump_defines_impl(const Defines& defines, const FuncDefines& function_defines);
-    static const std::unordered_map<std::string, std::string>& get_standard_includes();
 
-    const std::string& input_;
+    std::string_view input_;
     Defines defines_;
     FuncDefines function_defines_;
     const std::filesystem::path first_file_path_;
     std::filesystem::path current_path_;
+    // current_path_ as a string, the sink gets it with every line
+    std::string current_file_;
     size_t current_line_ = 0;
     int current_include_depth_ = 0;
-    std::stringstream out_stream_;
+    MacroFilter macro_filter_;
+    MacroExpander expander_;
+    // Reused for every text line to avoid allocating
+    std::string line_buffer_;
+    std::string expression_buffer_;
+    std::string expanded_expression_buffer_;
+    OutputSink* sink_ = nullptr;
+    // Set by load_precompiled_header, its output goes first
+    std::shared_ptr<const PrecompiledHeader> precompiled_header_;
+    // Only allocated when Global::GetStatsFormat() is set, added to the run's totals on destruction
+    std::unique_ptr<PreprocessorStats> stats_;
+    // Set by ScanDependencies
+    bool directives_only_ = false;
+    // Canonical paths of the included files in the order they are first included
+    std::vector<std::string> dependencies_;
+    std::unordered_set<std::string> dependency_set_;
     std::optional<PreprocessorError> current_error_ = std::nullopt;
+    // Canonical paths of included files mapped to their include guard macro
+    std::unordered_map<std::string, std::string> include_guards_;
+    std::unordered_set<std::string> pragma_once_files_;
+    bool cache_hit_ = false;
 
+    // Guards the latest defines, preprocessors may be destructed from many threads
+    static std::mutex& getLatestMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
     static Defines& getLatestDefines() {
         static Defines latest_defines_;
         return latest_defines_;
@@ -8,6 +8,8 @@ enum class PreprocessorError {
     IncludeDepth,
     IncludeNotFound,
     Directive,
+    Conditional,
+    Expression,
 
     Placeholder,
 };
@@ -18,6 +20,8 @@ static PreprocessorError getExpectedError(std::string define) {
         case hash("__TEST_ERROR_INCLUDE_DEPTH"): return PreprocessorError::IncludeDepth;
         case hash("__TEST_ERROR_NOT_FOUND"): return PreprocessorError::IncludeNotFound;
         case hash("__TEST_ERROR_DIRECTIVE"): return PreprocessorError::Directive;
+        case hash("__TEST_ERROR_CONDITIONAL"): return PreprocessorError::Conditional;
+        case hash("__TEST_ERROR_EXPRESSION"): return PreprocessorError::Expression;
         default: ERROR(define) return PreprocessorError::Placeholder;
     }
 }
@@ -0,0 +1,123 @@
+#include <preprocessor/preprocessor_stats.hxx>
+#include <misc/json.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace {
+    double to_ms(uint64_t ns) {
+        return ns / 1e6;
+    }
+
+    template <typename T>
+    std::vector<std::pair<std::string, T>> top_entries(const std::unordered_map<std::string, T>& map, size_t top, auto key) {
+        std::vector<std::pair<std::string, T>> entries(map.begin(), map.end());
+        std::sort(entries.begin(), entries.end(), [&](const auto& lhs, const auto& rhs) {
+            auto lhs_key = key(lhs.second), rhs_key = key(rhs.second);
+            return lhs_key != rhs_key ? lhs_key > rhs_key : lhs.first < rhs.first;
+        });
+        if (entries.size() > top)
+            entries.resize(top);
+        return entries;
+    }
+}
+
+PreprocessorStats::FileScope::FileScope(PreprocessorStats* stats, const std::string& path, uint64_t bytes)
+    : stats_(stats)
+{
+    if (!stats_)
+        return;
+    parent_ = stats_->current_;
+    parent_children_ns_ = stats_->children_ns_;
+    stats_->current_ = &stats_->files[path];
+    stats_->current_->includes++;
+    stats_->current_->bytes += bytes;
+    stats_->children_ns_ = 0;
+    start_ = Clock::now();
+}
+
+PreprocessorStats::FileScope::~FileScope() {
+    if (!stats_)
+        return;
+    auto inclusive = Elapsed(start_);
+    stats_->current_->inclusive_ns += inclusive;
+    stats_->current_->exclusive_ns += inclusive - std::min(inclusive, stats_->children_ns_);
+    stats_->current_ = parent_;
+    stats_->children_ns_ = parent_children_ns_ + inclusive;
+}
+
+void PreprocessorStats::Accumulate(const PreprocessorStats& stats) {
+    std::lock_guard<std::mutex> lock(get_mutex());
+    auto& total = get_total();
+    for (const auto& [path, file] : stats.files) {
+        auto& sum = total.files[path];
+        sum.includes += file.includes;
+        sum.skipped_includes += file.skipped_includes;
+        sum.inclusive_ns += file.inclusive_ns;
+        sum.exclusive_ns += file.exclusive_ns;
+        sum.expansion_ns += file.expansion_ns;
+        sum.directive_ns += file.directive_ns;
+        sum.bytes += file.bytes;
+        sum.lines_emitted += file.lines_emitted;
+        sum.lines_skipped += file.lines_skipped;
+    }
+    for (const auto& [name, macro] : stats.macros) {
+        auto& sum = total.macros[name];
+        sum.expansions += macro.expansions;
+        sum.ns += macro.ns;
+    }
+}
+
+std::string PreprocessorStats::Report(std::string_view format, size_t top) {
+    std::lock_guard<std::mutex> lock(get_mutex());
+    const auto& total = get_total();
+    auto files = top_entries(total.files, top, [](const File& file) { return file.inclusive_ns; });
+    auto macros = top_entries(total.macros, top, [](const Macro& macro) { return macro.expansions; });
+    if (format == "json") {
+        nlohmann::json j;
+        std::vector<nlohmann::json> file_objects;
+        for (const auto& [path, file] : files) {
+            nlohmann::json obj;
+            obj["File"] = path;
+            obj["Includes"] = file.includes;
+            obj["SkippedIncludes"] = file.skipped_includes;
+            obj["InclusiveMs"] = to_ms(file.inclusive_ns);
+            obj["ExclusiveMs"] = to_ms(file.exclusive_ns);
+            obj["ExpansionMs"] = to_ms(file.expansion_ns);
+            obj["DirectiveMs"] = to_ms(file.directive_ns);
+            obj["Bytes"] = file.bytes;
+            obj["LinesEmitted"] = file.lines_emitted;
+            obj["LinesSkipped"] = file.lines_skipped;
+            file_objects.push_back(obj);
+        }
+        std::vector<nlohmann::json> macro_objects;
+        for (const auto& [name, macro] : macros) {
+            nlohmann::json obj;
+            obj["Macro"] = name;
+            obj["Expansions"] = macro.expansions;
+            obj["Ms"] = to_ms(macro.ns);
+            macro_objects.push_back(obj);
+        }
+        j["Files"] = file_objects;
+        j["Macros"] = macro_objects;
+        return j.dump(4) + "\n";
+    }
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "Files by inclusive time:\n";
+    ss << std::setw(12) << "incl ms" << std::setw(12) << "excl ms" << std::setw(12) << "expand ms" << std::setw(14) << "directive ms"
+        << std::setw(10) << "included" << std::setw(10) << "skipped" << std::setw(12) << "bytes"
+        << std::setw(12) << "emitted" << std::setw(12) << "inactive" << "  file\n";
+    for (const auto& [path, file] : files) {
+        ss << std::setw(12) << to_ms(file.inclusive_ns) << std::setw(12) << to_ms(file.exclusive_ns)
+            << std::setw(12) << to_ms(file.expansion_ns) << std::setw(14) << to_ms(file.directive_ns)
+            << std::setw(10) << file.includes << std::setw(10) << file.skipped_includes << std::setw(12) << file.bytes
+            << std::setw(12) << file.lines_emitted << std::setw(12) << file.lines_skipped << "  " << path << "\n";
+    }
+    ss << "Macros by expansion count:\n";
+    ss << std::setw(12) << "expansions" << std::setw(12) << "ms" << "  macro\n";
+    for (const auto& [name, macro] : macros)
+        ss << std::setw(12) << macro.expansions << std::setw(12) << to_ms(macro.ns) << "  " << name << "\n";
+    return ss.str();
+}
@@ -0,0 +1,77 @@
+#ifndef PREPROCESSOR_STATS_HXX
+#define PREPROCESSOR_STATS_HXX
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Profile of a preprocessor run, collected when --pp-stats is given
+struct PreprocessorStats {
+    using Clock = std::chrono::steady_clock;
+
+    struct File {
+        // Times the file was processed, and times it was skipped because of its guard or #pragma once
+        uint64_t includes = 0;
+        uint64_t skipped_includes = 0;
+        // Inclusive time counts the files it includes too, exclusive time doesn't
+        uint64_t inclusive_ns = 0;
+        uint64_t exclusive_ns = 0;
+        // Parts of the exclusive time spent expanding text lines and handling directives
+        uint64_t expansion_ns = 0;
+        uint64_t directive_ns = 0;
+        uint64_t bytes = 0;
+        uint64_t lines_emitted = 0;
+        // Lines in inactive conditional regions
+        uint64_t lines_skipped = 0;
+    };
+
+    struct Macro {
+        uint64_t expansions = 0;
+        // Substituting the macro, not rescanning the result, which is counted towards the macros it contains
+        uint64_t ns = 0;
+    };
+
+    // Times a file from construction to destruction, so that an error thrown while
+    // processing it still leaves the parent's exclusive time right
+    class FileScope {
+    public:
+        // Does nothing if stats is null
+        FileScope(PreprocessorStats* stats, const std::string& path, uint64_t bytes);
+        ~FileScope();
+    private:
+        PreprocessorStats* stats_;
+        File* parent_ = nullptr;
+        uint64_t parent_children_ns_ = 0;
+        Clock::time_point start_;
+    };
+
+    std::unordered_map<std::string, File> files;
+    std::unordered_map<std::string, Macro> macros;
+
+    // File being processed, valid inside a FileScope
+    File& Current() { return *current_; }
+    static uint64_t Elapsed(Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    // Adds the stats of a preprocessor to the totals of the run
+    static void Accumulate(const PreprocessorStats& stats);
+    // Totals of the run, format is "text" or "json", lists the top files and macros
+    static std::string Report(std::string_view format, size_t top = 20);
+private:
+    File* current_ = nullptr;
+    // Inclusive time of the files included by the current one
+    uint64_t children_ns_ = 0;
+
+    static PreprocessorStats& get_total() {
+        static PreprocessorStats total;
+        return total;
+    }
+    static std::mutex& get_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+};
+#endif
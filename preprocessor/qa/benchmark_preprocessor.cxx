@@ -0,0 +1,44 @@
+#include <preprocessor/preprocessor.hxx>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Measures preprocessor throughput on generated code as the number of defined
+// macros grows. One in ten lines references a macro, the rest reference none
+namespace {
+    std::string generate_source(int define_count, int line_count) {
+        std::string source;
+        for (int i = 0; i < define_count; i++)
+            source += "#define BENCHMARK_MACRO_" + std::to_string(i) + " (" + std::to_string(i) + " + 1)\n";
+        for (int i = 0; i < line_count; i++) {
+            if (i % 10 == 0)
+                source += "    total_value += BENCHMARK_MACRO_" + std::to_string(i % define_count) + ";\n";
+            else
+                source += "    result_value = compute_total(input_buffer, offset + 42) * scale_factor;\n";
+        }
+        return source;
+    }
+}
+
+int main() {
+    constexpr int line_count = 200000;
+    constexpr int runs = 5;
+    std::cout << std::setw(10) << "defines" << std::setw(12) << "ms" << std::setw(12) << "MB/s" << std::endl;
+    for (int define_count : { 10, 100, 1000, 10000, 50000 }) {
+        auto source = generate_source(define_count, line_count);
+        double best = 0;
+        for (int run = 0; run < runs; run++) {
+            Preprocessor preprocessor(source);
+            auto start = std::chrono::steady_clock::now();
+            auto output = preprocessor.Process();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (run == 0 || elapsed.count() < best)
+                best = elapsed.count();
+        }
+        std::cout << std::setw(10) << define_count
+            << std::setw(12) << std::fixed << std::setprecision(1) << best * 1000
+            << std::setw(12) << source.size() / best / (1024 * 1024) << std::endl;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+
+
+int a = 1   + 2; 
+char* b = "// not a comment /* either */";
+char c = '"';   int d = 0;
+int e = 1   + 1;
+
+
+int f = 3;
\ No newline at end of file
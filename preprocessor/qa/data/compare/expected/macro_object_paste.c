@@ -0,0 +1,2 @@
+char p[] = "x ## y";
+int x1 = 0;
\ No newline at end of file
@@ -0,0 +1,5 @@
+const char* s = "hello \"world\"";
+int myvar = 2 + 2;
+int r = 3 * f(3);
+int xz = 10;
+int fooX = Xfoo;
\ No newline at end of file
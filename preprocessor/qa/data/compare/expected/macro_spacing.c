@@ -0,0 +1,7 @@
+int a = - - x;
+int b = + + y;
+int c = a / *p;
+int d = x 1;
+int e = - -1;
+int f = - >g;
+int g = -1;
\ No newline at end of file
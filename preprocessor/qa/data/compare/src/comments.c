@@ -0,0 +1,11 @@
+// Comments are removed before directives are processed
+#define VALUE 1 /* a block comment
+spanning lines */ + 2
+int a = VALUE; // trailing comment
+char* b = "// not a comment /* either */";
+char c = '"'; /* quote in a character constant */ int d = 0;
+int e = 1 /\
+* spliced comment opener */ + 1;
+// a line comment continued \
+onto the next line
+int f = 3;
\ No newline at end of file
@@ -0,0 +1,11 @@
+#define str(x) #x
+#define cat(a, b) a ## b
+#define twice(x) x + x
+#define f(x) x * f(x)
+#define glue3(a, b, c) a ## b ## c
+const char* s = str(  hello   "world" );
+int cat(my, var) = twice(2);
+int r = f(3);
+int glue3(x, , z) = glue3(, 1, 0);
+#define X 1
+int cat(foo, X) = cat(X, foo);
\ No newline at end of file
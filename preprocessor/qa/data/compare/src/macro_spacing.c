@@ -0,0 +1,12 @@
+#define NEG -
+#define PLUS +
+#define DIV /
+#define NUM 1
+#define ID(x) x
+int a = -NEG x;
+int b = +PLUS y;
+int c = a DIV*p;
+int d = ID(x)NUM;
+int e = NEG-1;
+int f = ID(-)>g;
+int g = -ID(1);
\ No newline at end of file
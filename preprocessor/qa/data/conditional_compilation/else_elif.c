@@ -0,0 +1,25 @@
+// Tests #else, #elif and nested conditionals, including ones inside inactive regions
+#define A
+#ifdef B
+#define __TEST_FAILED
+#if defined(A)
+#else
+#define __TEST_FAILED
+#endif
+#elif defined(B)
+#define __TEST_FAILED
+#else
+#ifndef A
+#define __TEST_FAILED
+#else
+#ifdef A
+#define __TEST_STEP
+#endif
+#endif
+#endif
+#ifdef __TEST_FAILED
+#elif defined(__TEST_STEP)
+#define __TEST_PASSED
+#else
+#undef __TEST_PASSED
+#endif
\ No newline at end of file
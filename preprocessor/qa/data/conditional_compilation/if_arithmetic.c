@@ -0,0 +1,13 @@
+// Tests integer arithmetic, comparisons, the ternary operator and macro expansion in #if
+#define VERSION 3
+#define MAJOR(v) ((v) / 10)
+#define EMPTY
+#if VERSION >= 3 && MAJOR(VERSION * 10 + 7) == 3 && !defined UNDEFINED_MACRO
+#if (1 ? 2 : 0) == 2 && (0 || 0 ? 1 : -1) < 0 && -1 < 0u == 0 && (0 && 1 / 0) == 0
+#if 0x10 + 010 + 0b1 + 'A' == 16 + 8 + 1 + 65 && (1 << 4 | 1) == 17 && ~0 == -1 && 7 % 4 == 3
+#if defined(MAJOR) && EMPTY 1 && UNDEFINED_MACRO == 0
+#define __TEST_PASSED
+#endif
+#endif
+#endif
+#endif
\ No newline at end of file
@@ -0,0 +1,5 @@
+// Tests that a guarded header is entered again once its guard is undefined
+#include "../include/guarded.h"
+#undef GUARDED_H
+#undef __TEST_PASSED
+#include "../include/guarded.h"
\ No newline at end of file
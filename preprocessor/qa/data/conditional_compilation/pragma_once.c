@@ -0,0 +1,3 @@
+// Tests that a header marked with #pragma once is only included once
+#include "../include/pragma_once.h"
+#include "../include/pragma_once.h"
\ No newline at end of file
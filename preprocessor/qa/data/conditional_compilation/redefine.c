@@ -0,0 +1,11 @@
+// Tests that a macro can be undefined and defined again
+#define VALUE 1
+#undef VALUE
+#define VALUE 2
+#undef VALUE
+#define VALUE(x) x
+#undef VALUE
+#define VALUE 3
+#if VALUE == 3 && !defined(OTHER)
+#define __TEST_PASSED
+#endif
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef GUARDED_H
+#define GUARDED_H
+#ifdef GUARDED_H
+#define __TEST_PASSED
+#endif
+#endif
@@ -0,0 +1,8 @@
+#pragma once
+#ifdef __ONCE_SEEN
+#undef __TEST_PASSED
+#endif
+#ifndef __ONCE_SEEN
+#define __ONCE_SEEN
+#define __TEST_PASSED
+#endif
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef PRELUDE_H
+#define PRELUDE_H
+#define PRELUDE_SIZE 16
+#define PRELUDE_MAX(a, b) ((a) > (b) ? (a) : (b))
+int prelude_buffer[PRELUDE_SIZE];
+#endif
\ No newline at end of file
@@ -0,0 +1 @@
+#define SEARCH_FIRST
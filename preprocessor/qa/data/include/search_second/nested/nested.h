@@ -0,0 +1,3 @@
+#ifdef SEARCH_FIRST
+#define __TEST_PASSED
+#endif
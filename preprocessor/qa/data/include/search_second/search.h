@@ -0,0 +1,2 @@
+// Shadowed by the copy in search_first
+#error "search_second/search.h should not be included"
@@ -0,0 +1,2 @@
+// Tests that quoted includes are found next to a file given without a directory
+#include "quoted.h"
\ No newline at end of file
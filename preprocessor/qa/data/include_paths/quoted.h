@@ -0,0 +1 @@
+#define __TEST_PASSED
\ No newline at end of file
@@ -0,0 +1,3 @@
+// Tests that angled includes are searched for in the -I directories in order
+#include <search.h>
+#include <nested/nested.h>
\ No newline at end of file
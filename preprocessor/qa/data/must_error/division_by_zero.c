@@ -0,0 +1,3 @@
+#define __TEST_ERROR_EXPRESSION
+#if 1 / (2 - 2)
+#endif
\ No newline at end of file
@@ -0,0 +1,3 @@
+#define __TEST_ERROR_CONDITIONAL
+#ifdef __TEST_ERROR_CONDITIONAL
+#ifndef __TEST_ERROR_CONDITIONAL
\ No newline at end of file
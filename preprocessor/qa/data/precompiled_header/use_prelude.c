@@ -0,0 +1,4 @@
+// Tests that a file processed with a precompiled header sees its macros
+// and skips including the header again
+#include "../include/prelude.h"
+int size = PRELUDE_MAX(PRELUDE_SIZE, 8);
\ No newline at end of file
@@ -0,0 +1,4 @@
+int a; /* multi
+line
+comment */
+int b = __LINE__;
@@ -1,19 +1,34 @@
 #include <preprocessor/preprocessor.hxx>
+#include <preprocessor/precompiled_header.hxx>
 #include <common/qa/test_base.hxx>
 #include <common/qa/defines.hxx>
 #include <common/global.hxx>
+#include <misc/json.hpp>
 #include <filesystem>
+#include <fstream>
 
 class TestPreprocessor : public TestBase {
     void preprocessConditionalCompilationFiles();
     void preprocessErrorFiles();
     void preprocessPredefinedMacroFiles();
     void preprocessFilesWithExpected();
+    void preprocessWithPrecompiledHeader();
+    void preprocessToSink();
+    void scanDependencies();
+    void preprocessWithCache();
+    void preprocessWithIncludePaths();
+    void preprocessWithStats();
     CPPUNIT_TEST_SUITE(TestPreprocessor);
     CPPUNIT_TEST(preprocessConditionalCompilationFiles);
     CPPUNIT_TEST(preprocessErrorFiles);
     CPPUNIT_TEST(preprocessPredefinedMacroFiles);
     CPPUNIT_TEST(preprocessFilesWithExpected);
+    CPPUNIT_TEST(preprocessWithPrecompiledHeader);
+    CPPUNIT_TEST(preprocessToSink);
+    CPPUNIT_TEST(scanDependencies);
+    CPPUNIT_TEST(preprocessWithCache);
+    CPPUNIT_TEST(preprocessWithIncludePaths);
+    CPPUNIT_TEST(preprocessWithStats);
     CPPUNIT_TEST_SUITE_END();
 };
 
@@ -110,6 +125,19 @@ void TestPreprocessor::preprocessPredefinedMacroFiles() {
             "int b = 3;";
         CPPUNIT_ASSERT_EQUAL_MESSAGE("Line numbers don't match!", expected, actual);
     }
+    {
+        // Block comments keep the newlines inside them
+        auto cur_path = path + "line_comment.c";
+        auto str = getSource(cur_path);
+        Preprocessor preprocessor(str);
+        auto actual = preprocessor.Process();
+        std::string expected =
+            "int a;  \n"
+            "\n"
+            "\n"
+            "int b = 4;";
+        CPPUNIT_ASSERT_EQUAL_MESSAGE("Line numbers after a comment don't match!", expected, actual);
+    }
 }
 
 void TestPreprocessor::preprocessFilesWithExpected() {
@@ -130,4 +158,201 @@ void TestPreprocessor::preprocessFilesWithExpected() {
     }
 }
 
+void TestPreprocessor::preprocessWithPrecompiledHeader() {
+    auto header_path = getDataPath() + "/include/prelude.h";
+    auto pch_path = std::filesystem::temp_directory_path() / "prelude.h.pch";
+    {
+        auto str = getSource(header_path);
+        Preprocessor preprocessor(str);
+        auto output = preprocessor.Process();
+        CPPUNIT_ASSERT(PrecompiledHeader::Save(pch_path, preprocessor, output));
+    }
+    auto str = getSource(getDataPath() + "/precompiled_header/use_prelude.c");
+    Global::GetPchPath() = pch_path.string();
+    Preprocessor preprocessor(str);
+    auto actual = preprocessor.Process();
+    Global::GetPchPath() = "";
+    std::filesystem::remove(pch_path);
+    std::string expected =
+        "int prelude_buffer[16];\n"
+        "\n"
+        "\n"
+        "\n"
+        "\n"
+        "int size = ((16) > (8) ? (16) : (8));";
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("Sources don't match!", expected, actual);
+    CPPUNIT_ASSERT(preprocessor.IsDefined("PRELUDE_H"));
+    // A corrupt parameter count is rejected instead of allocating billions of strings
+    std::string corrupt;
+    auto append = [&corrupt](uint32_t value) { corrupt.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    append(0);
+    append(1);
+    append(1);
+    corrupt += 'f';
+    append(UINT32_MAX);
+    PrecompiledHeader pch;
+    CPPUNIT_ASSERT(!PrecompiledHeader::Deserialize(corrupt, pch));
+}
+
+void TestPreprocessor::preprocessToSink() {
+    const auto& src_files = getDataFiles("compare/src");
+    for (auto& path : src_files) {
+        auto src = getSource(path);
+        std::string expected;
+        {
+            Preprocessor preprocessor(src);
+            expected = preprocessor.Process();
+        }
+        std::string actual;
+        size_t chunks = 0;
+        CallbackSink sink([&](std::string_view chunk) {
+            actual += chunk;
+            chunks++;
+        });
+        Preprocessor preprocessor(src);
+        preprocessor.Process(sink);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE("Streamed output doesn't match: " + path, expected, actual);
+        CPPUNIT_ASSERT(expected.empty() || chunks > 0);
+    }
+}
+
+void TestPreprocessor::scanDependencies() {
+    // Conditionals must be evaluated the same way when only scanning directives
+    const auto& files = getDataFiles("conditional_compilation");
+    for (auto& path : files) {
+        auto str = getSource(path);
+        Preprocessor preprocessor(str, path);
+        preprocessor.ScanDependencies();
+        CPPUNIT_ASSERT_MESSAGE("Failed file: " + path, preprocessor.IsDefined(__TEST_PASSED));
+    }
+    auto path = getDataPath() + "/conditional_compilation/include_guard.c";
+    auto str = getSource(path);
+    Preprocessor preprocessor(str, path);
+    auto dependencies = preprocessor.ScanDependencies();
+    auto guarded = std::filesystem::canonical(getDataPath() + "/include/guarded.h").string();
+    CPPUNIT_ASSERT_EQUAL(std::vector<std::string>{ guarded }, dependencies);
+}
+
+void TestPreprocessor::preprocessWithCache() {
+    auto directory = std::filesystem::temp_directory_path() / "preprocessor_cache_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "cache");
+    auto source_path = (directory / "main.c").string();
+    auto header_path = directory / "header.h";
+    std::string source = "#include \"header.h\"\nint x = VALUE;";
+    std::ofstream(source_path) << source;
+    std::ofstream(header_path) << "#define VALUE 1";
+    Global::GetCacheDir() = (directory / "cache").string();
+    auto process = [&](std::string_view input, const std::string& path, bool expect_hit) {
+        Preprocessor preprocessor(input, path);
+        auto output = preprocessor.Process();
+        CPPUNIT_ASSERT_EQUAL(expect_hit, preprocessor.IsCacheHit());
+        // The header's define is restored from the entry on a hit
+        CPPUNIT_ASSERT(preprocessor.IsDefined("VALUE"));
+        return output;
+    };
+    auto entries = [&directory]() {
+        std::vector<std::string> names;
+        for (const auto& file : std::filesystem::directory_iterator(directory / "cache"))
+            names.push_back(file.path().filename().string());
+        return names;
+    };
+    std::string expected = "\nint x = 1;";
+    CPPUNIT_ASSERT_EQUAL(expected, process(source, source_path, false));
+    CPPUNIT_ASSERT_EQUAL(expected, process(source, source_path, true));
+    // A changed include invalidates the entry
+    std::ofstream(header_path) << "#define VALUE 2";
+    expected = "\nint x = 2;";
+    CPPUNIT_ASSERT_EQUAL(expected, process(source, source_path, false));
+    CPPUNIT_ASSERT_EQUAL(expected, process(source, source_path, true));
+    // A cache that only fits one entry keeps the most recent one
+    CPPUNIT_ASSERT_EQUAL(size_t(1), entries().size());
+    auto source_entry = entries()[0];
+    auto entry_size = std::filesystem::file_size(directory / "cache" / source_entry);
+    Global::GetCacheSize() = entry_size + entry_size / 2;
+    auto other_path = (directory / "other.c").string();
+    process(source, other_path, false);
+    CPPUNIT_ASSERT_EQUAL(size_t(1), entries().size());
+    CPPUNIT_ASSERT(entries()[0] != source_entry);
+    process(source, source_path, false);
+    CPPUNIT_ASSERT_EQUAL(size_t(1), entries().size());
+    CPPUNIT_ASSERT_EQUAL(source_entry, entries()[0]);
+    Global::GetCacheSize() = 512ull * 1024 * 1024;
+    // Sinks get the same locations on a hit as on a miss
+    struct LocationSink : public OutputSink {
+        std::string output;
+        std::vector<std::pair<std::string, size_t>> locations;
+        void Write(std::string_view chunk) override { output += chunk; }
+        void SetLocation(std::string_view file, size_t line) override { locations.emplace_back(file, line); }
+    };
+    auto located_path = (directory / "located.c").string();
+    LocationSink miss;
+    Preprocessor miss_preprocessor(source, located_path);
+    miss_preprocessor.Process(miss);
+    CPPUNIT_ASSERT(!miss_preprocessor.IsCacheHit());
+    CPPUNIT_ASSERT(!miss.locations.empty());
+    CPPUNIT_ASSERT(miss.locations.back() == std::make_pair(located_path, size_t(2)));
+    LocationSink hit;
+    Preprocessor hit_preprocessor(source, located_path);
+    hit_preprocessor.Process(hit);
+    CPPUNIT_ASSERT(hit_preprocessor.IsCacheHit());
+    CPPUNIT_ASSERT_EQUAL(miss.output, hit.output);
+    CPPUNIT_ASSERT(hit.locations.back() == std::make_pair(located_path, size_t(2)));
+    Global::GetCacheDir() = "";
+    std::filesystem::remove_all(directory);
+}
+
+void TestPreprocessor::preprocessWithIncludePaths() {
+    IncludePaths::AddDirectory(getDataPath() + "/include/search_first", false);
+    IncludePaths::AddDirectory(getDataPath() + "/include/search_second", true);
+    auto path = getDataPath() + "/include_paths/search.c";
+    auto str = getSource(path);
+    Preprocessor preprocessor(str, path);
+    preprocessor.Process();
+    CPPUNIT_ASSERT(!preprocessor.IsError());
+    CPPUNIT_ASSERT(preprocessor.IsDefined(__TEST_PASSED));
+    IncludePaths::Clear();
+    // Without the directories the same include is not found, even though it was found before
+    Preprocessor missing(str, path);
+    try {
+        missing.Process();
+    } catch (const std::exception&) {}
+    CPPUNIT_ASSERT_EQUAL(PreprocessorError::IncludeNotFound, missing.GetError());
+    // Quoted includes of a file given as a bare relative path are looked for in the working directory
+    auto working_directory = std::filesystem::current_path();
+    std::filesystem::current_path(getDataPath() + "/include_paths");
+    auto quoted = getSource("quoted.c");
+    Preprocessor relative(quoted, "quoted.c");
+    try {
+        relative.Process();
+    } catch (const std::exception&) {}
+    std::filesystem::current_path(working_directory);
+    CPPUNIT_ASSERT(!relative.IsError());
+    CPPUNIT_ASSERT(relative.IsDefined(__TEST_PASSED));
+}
+
+void TestPreprocessor::preprocessWithStats() {
+    auto path = getDataPath() + "/conditional_compilation/pragma_once.c";
+    auto str = getSource(path);
+    Global::GetStatsFormat() = "json";
+    {
+        Preprocessor preprocessor(str, path);
+        preprocessor.Process();
+    }
+    Global::GetStatsFormat() = "";
+    auto report = nlohmann::json::parse(PreprocessorStats::Report("json"));
+    auto header = std::filesystem::canonical(getDataPath() + "/include/pragma_once.h").string();
+    bool found = false;
+    for (const auto& file : report["Files"]) {
+        if (file["File"] != header)
+            continue;
+        found = true;
+        // The second include is skipped because of #pragma once
+        CPPUNIT_ASSERT_EQUAL(1, file["Includes"].get<int>());
+        CPPUNIT_ASSERT_EQUAL(1, file["SkippedIncludes"].get<int>());
+        CPPUNIT_ASSERT(file["InclusiveMs"].get<double>() >= file["ExclusiveMs"].get<double>());
+    }
+    CPPUNIT_ASSERT(found);
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(TestPreprocessor);
\ No newline at end of file
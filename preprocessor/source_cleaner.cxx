@@ -0,0 +1,201 @@
+#include <preprocessor/source_cleaner.hxx>
+#include <algorithm>
+#include <cstring>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Index of the first character in text[i..] that is one of Cs, or text.size()
+    template <char... Cs>
+    size_t find_any(std::string_view text, size_t i) {
+        const char* data = text.data();
+        const size_t size = text.size();
+        #if defined(__AVX2__)
+        for (; i + 32 <= size; i += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i matches = _mm256_setzero_si256();
+            ((matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(Cs)))), ...);
+            unsigned mask = _mm256_movemask_epi8(matches);
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+        #endif
+        #if defined(__SSE2__)
+        for (; i + 16 <= size; i += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i matches = _mm_setzero_si128();
+            ((matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(Cs)))), ...);
+            unsigned mask = _mm_movemask_epi8(matches);
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+        #endif
+        for (; i < size; i++) {
+            char c = data[i];
+            if (((c == Cs) || ...))
+                return i;
+        }
+        return size;
+    }
+
+    // Length of the backslash-newline at i, 0 if there's none
+    size_t splice_length(std::string_view text, size_t i) {
+        if (i + 1 < text.size() && text[i] == '\\') {
+            if (text[i + 1] == '\n')
+                return 2;
+            if (text[i + 1] == '\r' && i + 2 < text.size() && text[i + 2] == '\n')
+                return 3;
+        }
+        return 0;
+    }
+
+    // Index of the next character after i that isn't part of a backslash-newline
+    size_t skip_splices(std::string_view text, size_t i) {
+        while (size_t length = splice_length(text, i))
+            i += length;
+        return i;
+    }
+
+    class Cleaner {
+    public:
+        Cleaner(std::string_view input, std::string& out) : input_(input), out_(out) {}
+
+        bool Clean() {
+            const size_t size = input_.size();
+            size_t i = 0;
+            while ((i = next_candidate(i)) < size) {
+                switch (input_[i]) {
+                    case '\n': {
+                        // The newlines of the block comments on this line go after it
+                        drop(i + 1, i + 1);
+                        out_.append(pending_newlines_, '\n');
+                        pending_newlines_ = 0;
+                        i++;
+                        break;
+                    }
+                    case '\\': {
+                        if (size_t length = splice_length(input_, i)) {
+                            drop(i, i + length);
+                            i += length;
+                        } else {
+                            i++;
+                        }
+                        break;
+                    }
+                    case '"':
+                    case '\'': {
+                        i = skip_literal(i);
+                        break;
+                    }
+                    case '/': {
+                        size_t next = skip_splices(input_, i + 1);
+                        if (next < size && input_[next] == '/')
+                            i = skip_line_comment(i, next + 1);
+                        else if (next < size && input_[next] == '*')
+                            i = skip_block_comment(i, next + 1);
+                        else
+                            i++;
+                        break;
+                    }
+                }
+            }
+            if (!changed_)
+                return false;
+            out_.append(input_.substr(copied_));
+            out_.append(pending_newlines_, '\n');
+            return true;
+        }
+    private:
+        // Newlines only need to be found while there are comment newlines to put back
+        size_t next_candidate(size_t i) {
+            if (pending_newlines_)
+                return find_any<'/', '"', '\'', '\\', '\n'>(input_, i);
+            return find_any<'/', '"', '\'', '\\'>(input_, i);
+        }
+
+        // Copies the clean span before begin and skips begin..end
+        void drop(size_t begin, size_t end) {
+            if (!changed_) {
+                out_.reserve(out_.size() + input_.size());
+                changed_ = true;
+            }
+            out_.append(input_.substr(copied_, begin - copied_));
+            copied_ = end;
+        }
+
+        // Returns the index after the closing quote, literals end at a newline if unterminated
+        size_t skip_literal(size_t i) {
+            const char quote = input_[i];
+            const size_t size = input_.size();
+            i++;
+            while (true) {
+                i = quote == '"' ? find_any<'"', '\\', '\n'>(input_, i) : find_any<'\'', '\\', '\n'>(input_, i);
+                if (i >= size || input_[i] == '\n')
+                    return i;
+                if (input_[i] == quote)
+                    return i + 1;
+                if (size_t length = splice_length(input_, i)) {
+                    drop(i, i + length);
+                    i += length;
+                } else {
+                    // Escape sequence, the escaped character can't end the literal
+                    i += 2;
+                }
+            }
+        }
+
+        // Removes the comment, keeping the newline that ends it
+        size_t skip_line_comment(size_t begin, size_t i) {
+            const size_t size = input_.size();
+            while (true) {
+                i = find_any<'\n', '\\'>(input_, i);
+                if (i >= size || input_[i] == '\n')
+                    break;
+                // A backslash-newline continues the comment on the next line
+                size_t length = splice_length(input_, i);
+                i += length ? length : 1;
+            }
+            drop(begin, i);
+            return i;
+        }
+
+        // Replaces the comment with a single space. The newlines inside it are put back at
+        // the end of the line, which keeps the line going for directives and expressions
+        // while the lines after it keep their numbers
+        size_t skip_block_comment(size_t begin, size_t i) {
+            const size_t size = input_.size();
+            while (true) {
+                auto star = static_cast<const char*>(std::memchr(input_.data() + i, '*', size - i));
+                if (!star) {
+                    // Unterminated, the comment runs to the end of the file
+                    i = size;
+                    break;
+                }
+                i = star - input_.data() + 1;
+                size_t next = skip_splices(input_, i);
+                if (next < size && input_[next] == '/') {
+                    i = next + 1;
+                    break;
+                }
+            }
+            auto newlines = std::count(input_.begin() + begin, input_.begin() + i, '\n');
+            drop(begin, i);
+            out_ += ' ';
+            pending_newlines_ += newlines;
+            return i;
+        }
+
+        std::string_view input_;
+        std::string& out_;
+        // Everything before this index was copied or dropped
+        size_t copied_ = 0;
+        bool changed_ = false;
+        size_t pending_newlines_ = 0;
+    };
+}
+
+bool SourceCleaner::Clean(std::string_view input, std::string& out) {
+    Cleaner cleaner(input, out);
+    return cleaner.Clean();
+}
\ No newline at end of file
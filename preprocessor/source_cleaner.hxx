@@ -0,0 +1,15 @@
+#ifndef SOURCE_CLEANER_HXX
+#define SOURCE_CLEANER_HXX
+#include <string>
+#include <string_view>
+
+// Splices backslash-newlines and replaces comments with a single space in one pass,
+// the newlines of block comments are kept at the end of their line.
+// Candidate characters are searched 16 or 32 bytes at a time with SSE2/AVX2 where
+// available, and the spans between them are copied in bulk
+struct SourceCleaner {
+    // Appends the cleaned text to out, returns false and leaves out untouched
+    // if the input has nothing to clean
+    static bool Clean(std::string_view input, std::string& out);
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef KEYWORDS_HXX
+#define KEYWORDS_HXX
+#include <token/token.hxx>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+// Perfect hash over the KEYWORD entries of tokens.def. The slot of a word only depends
+// on its length and its first and last characters, with multipliers that are searched
+// for at compile time so that no two keywords share a slot
+namespace keyword_hash {
+    struct Keyword {
+        std::string_view spelling;
+        TokenType type = TokenType::Empty;
+    };
+
+    inline constexpr Keyword keywords[] = {
+        #define DEF(x, y)
+        #define KEYWORD(x, y, spelling) { spelling, TokenType::x },
+        #include <token/tokens.def>
+        #undef KEYWORD
+        #undef DEF
+    };
+
+    inline constexpr size_t table_size = 128;
+
+    struct Multipliers {
+        uint32_t first = 0;
+        uint32_t last = 0;
+    };
+
+    constexpr size_t slot(std::string_view word, Multipliers multipliers) {
+        return (static_cast<unsigned char>(word.front()) * multipliers.first
+            + static_cast<unsigned char>(word.back()) * multipliers.last
+            + word.size()) % table_size;
+    }
+
+    constexpr Multipliers find_multipliers() {
+        for (uint32_t first = 1; first < 256; first++) {
+            for (uint32_t last = 0; last < 256; last++) {
+                bool used[table_size] = {};
+                bool collision = false;
+                for (const auto& keyword : keywords) {
+                    auto index = slot(keyword.spelling, { first, last });
+                    if (used[index]) {
+                        collision = true;
+                        break;
+                    }
+                    used[index] = true;
+                }
+                if (!collision)
+                    return { first, last };
+            }
+        }
+        return {};
+    }
+
+    inline constexpr Multipliers multipliers = find_multipliers();
+    static_assert(multipliers.first != 0, "No perfect hash for the keywords, increase table_size");
+
+    inline constexpr auto table = [] {
+        std::array<Keyword, table_size> ret {};
+        for (const auto& keyword : keywords)
+            ret[slot(keyword.spelling, multipliers)] = keyword;
+        return ret;
+    }();
+
+    inline constexpr auto length_range = [] {
+        std::pair<size_t, size_t> ret { SIZE_MAX, 0 };
+        for (const auto& keyword : keywords) {
+            ret.first = std::min(ret.first, keyword.spelling.size());
+            ret.second = std::max(ret.second, keyword.spelling.size());
+        }
+        return ret;
+    }();
+}
+
+// Returns TokenType::Empty if the word is not a keyword, one probe and one memcmp
+static inline TokenType find_keyword(std::string_view word) {
+    using namespace keyword_hash;
+    if (word.size() < length_range.first || word.size() > length_range.second)
+        return TokenType::Empty;
+    const auto& keyword = table[slot(word, multipliers)];
+    if (keyword.spelling.size() != word.size() || std::memcmp(keyword.spelling.data(), word.data(), word.size()) != 0)
+        return TokenType::Empty;
+    return keyword.type;
+}
+#endif
@@ -1,9 +1,10 @@
 #ifndef TOKEN_HXX
 #define TOKEN_HXX
-#include <misc/json.hpp>
 #include <common/str_hash.hxx>
-#include <cctype>
-#include <tuple>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
 
 enum class TokenType {
     Error,
@@ -12,7 +13,15 @@ enum class TokenType {
     #undef DEF
 };
 
-using Token = std::tuple<TokenType, std::string>;
+// The text of a token is a span of the source it was lexed from, so tokens don't
+// allocate and the source has to outlive them. Sources are limited to 4GB
+struct Token {
+    TokenType type = TokenType::Empty;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+
+    std::string_view Text(std::string_view source) const { return source.substr(offset, length); }
+};
 
 static inline std::ostream& operator<<(std::ostream& o, TokenType e) {
     switch (e) {
@@ -41,21 +50,4 @@ static inline TokenType serialize(std::string e) {
     }
 }
 
-static inline TokenType serialize_l(std::string e) {
-    e[0] = std::toupper(e[0]);
-    return serialize(e);
-}
-
-static inline std::ostream& operator<<(std::ostream& o, const std::vector<Token>& tokens) {
-    nlohmann::json j;
-    std::vector<nlohmann::json> objects;
-    for (const auto& [type, value] : tokens) {
-        nlohmann::json obj;
-        obj[deserialize(type)] = value;
-        objects.push_back(obj);
-    }
-    j["Tokens"] = objects;
-    return o << j;
-}
-
 #endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef TOKEN_BUFFER_HXX
+#define TOKEN_BUFFER_HXX
+#include <misc/json.hpp>
+#include <common/log.hxx>
+#include <token/token.hxx>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#define DEF(x, y) static_assert(y <= UINT8_MAX, "TokenType::" #x " doesn't fit in a byte");
+#include <token/tokens.def>
+#undef DEF
+
+// Tokens stored as separate arrays over the text they were lexed from. The parser looks
+// ahead and backtracks over the kinds far more often than it reads any text, so the kinds
+// get their own dense array of one byte each. Locations are only needed for diagnostics,
+// so they're found from a table of line starts and the source line each output line came
+// from instead of stored per token
+class TokenBuffer {
+public:
+    // 1-based. The file is empty when the origin of the line wasn't recorded, as for
+    // output restored from the cache, then the line and column are in the preprocessed text
+    struct Location {
+        std::string_view file;
+        size_t line;
+        size_t column;
+    };
+
+    // Returns the offset of the text, which tokens lexed from it have to be shifted by.
+    // Throws if the source would outgrow the 32 bit offsets
+    uint32_t AppendSource(std::string_view text) {
+        if (text.size() > UINT32_MAX - source_.size()) {
+            ERROR("Token source is larger than 4GB: " << source_.size() + text.size() << " bytes");
+            throw std::runtime_error("Token source too large");
+        }
+        auto offset = static_cast<uint32_t>(source_.size());
+        source_ += text;
+        for (auto i = text.find('\n'); i != std::string_view::npos; i = text.find('\n', i + 1))
+            line_starts_.push_back(offset + static_cast<uint32_t>(i) + 1);
+        return offset;
+    }
+
+    // The text appended next starts at this line of the file, the lines after it follow on
+    void SetOrigin(std::string_view file, size_t line) {
+        if (files_.empty() || files_[last_file_] != file) {
+            auto it = file_ids_.find(file);
+            if (it == file_ids_.end()) {
+                it = file_ids_.emplace(file, static_cast<uint32_t>(files_.size())).first;
+                files_.push_back(std::string(file));
+            }
+            last_file_ = it->second;
+        }
+        auto output_line = static_cast<uint32_t>(line_starts_.size() - 1);
+        if (!origins_.empty() && origins_.back().output_line == output_line)
+            origins_.pop_back();
+        origins_.push_back({ output_line, last_file_, static_cast<uint32_t>(line) });
+    }
+
+    void Append(TokenType type, uint32_t offset, uint32_t length) {
+        kinds_.push_back(static_cast<uint8_t>(type));
+        offsets_.push_back(offset);
+        lengths_.push_back(length);
+    }
+
+    // Adds the end of file token after the last of the source
+    void AppendEof() { Append(TokenType::Eof, static_cast<uint32_t>(source_.size()), 0); }
+
+    size_t Size() const { return kinds_.size(); }
+    TokenType Kind(size_t i) const { return static_cast<TokenType>(kinds_[i]); }
+    std::string_view Text(size_t i) const { return std::string_view(source_).substr(offsets_[i], lengths_[i]); }
+    Token Get(size_t i) const { return { Kind(i), offsets_[i], lengths_[i] }; }
+    std::string_view Source() const { return source_; }
+
+    Location GetLocation(size_t i) const {
+        // 0-based line of the source
+        auto line = static_cast<uint32_t>(std::upper_bound(line_starts_.begin(), line_starts_.end(), offsets_[i]) - line_starts_.begin() - 1);
+        size_t column = offsets_[i] - line_starts_[line] + 1;
+        auto origin = std::upper_bound(origins_.begin(), origins_.end(), line,
+            [](uint32_t line, const Origin& origin) { return line < origin.output_line; });
+        if (origin == origins_.begin())
+            return { {}, static_cast<size_t>(line) + 1, column };
+        --origin;
+        return { files_[origin->file], static_cast<size_t>(origin->line) + line - origin->output_line, column };
+    }
+private:
+    // Lets file_ids_ be searched with a string_view without building a string
+    struct FileHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view file) const { return std::hash<std::string_view>{}(file); }
+    };
+
+    struct Origin {
+        uint32_t output_line;
+        uint32_t file;
+        uint32_t line;
+    };
+
+    std::string source_;
+    std::vector<uint8_t> kinds_;
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> lengths_;
+    std::vector<uint32_t> line_starts_ { 0 };
+    // Sorted by output line
+    std::vector<Origin> origins_;
+    std::vector<std::string> files_;
+    std::unordered_map<std::string, uint32_t, FileHash, std::equal_to<>> file_ids_;
+    uint32_t last_file_ = 0;
+};
+
+static inline nlohmann::json to_json(const TokenBuffer& tokens) {
+    nlohmann::json j;
+    std::vector<nlohmann::json> objects;
+    for (size_t i = 0; i < tokens.Size(); i++) {
+        nlohmann::json obj;
+        obj[deserialize(tokens.Kind(i))] = tokens.Text(i);
+        objects.push_back(obj);
+    }
+    j["Tokens"] = objects;
+    return j;
+}
+#endif